@@ -0,0 +1,68 @@
+// Host-only example: validates the step counter and activity classifier
+// on a recorded capture. Build with a Linux Arduino emulation layer and
+// set MSA300_TRACE to a capture written by capture_log.ino at 31.25 Hz
+// or 62.5 Hz.
+#include <MSA300.h>
+#include <MSA300Sim.h>
+#include <MSA300Replay.h>
+#include <MSA300Activity.h>
+#include <stdlib.h>
+
+MSA300Sim sim;
+MSA300 accel = MSA300(sim, 1234);
+MSA300Replay replay(accel, sim);
+MSA300LogReader reader;
+MSA300Activity activity;
+
+const char *names[] = {"unknown", "rest", "walk", "run", "vehicle"};
+uint32_t seconds[5];
+
+void onEvent(uint32_t time, const interrupt_t &interrupts, void *context) {
+    if(!interrupts.newDataInt()) {
+        return;
+    }
+
+    rawAcc_t sample;
+    accel.getRawAcceleration(&sample);
+    if(activity.update(&sample)) {
+        seconds[activity.activity()] += MSA300_ACTIVITY_WINDOW_MS;
+    }
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    const char *path = getenv("MSA300_TRACE");
+    if(!path || !reader.open(path)) {
+        Serial.println("Set MSA300_TRACE to a capture file");
+        return;
+    }
+
+    const msa300LogHeader_t *header = reader.header();
+    accel.begin();
+    replay.configure(header);
+    if(!activity.begin((dataRate_t)header->dataRate, (range_t)header->range)) {
+        Serial.println("Capture must be at 31.25 Hz or 62.5 Hz");
+        return;
+    }
+
+    // Every sample goes through the driver, as it would on the device
+    accel.setInterruptLatch(MSA300_INT_NON_LATCHED);
+    accel.enableNewDataInterrupt(1);
+    replay.setPolling(true);
+    replay.onEvent(onEvent, NULL);
+    replay.run(reader);
+
+    Serial.print("Steps: ");
+    Serial.println(activity.steps());
+    for(uint8_t i = 0; i < 5; i++) {
+        Serial.print(names[i]);
+        Serial.print(": ");
+        Serial.print(seconds[i] / 1000);
+        Serial.println(" s");
+    }
+}
+
+void loop() {
+}
@@ -0,0 +1,172 @@
+// Measures driver cost per operation and prints the results as JSON.
+// By default the driver runs against the simulated chip, which also
+// counts bus traffic for I2C and SPI framing. Define BENCH_HARDWARE_I2C or
+// BENCH_HARDWARE_SPI to time a real sensor instead.
+#include <MSA300.h>
+#include <MSA300Sim.h>
+#include <MSA300Pack.h>
+#include <Wire.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define ITERATIONS 1000
+
+#if defined(BENCH_HARDWARE_I2C)
+MSA300 accel = MSA300(1234);
+#elif defined(BENCH_HARDWARE_SPI)
+MSA300 accel = MSA300(13, 12, 11, 10, 1234);
+#else
+#define BENCH_SIM
+MSA300Sim sim;
+MSA300 accel = MSA300(sim, 1234);
+#endif
+
+rawAcc_t raw;
+acc_t acc;
+frame_t frame;
+rawAcc_t block[64];
+uint8_t packed[3 * 64 * 14 / 8];
+
+// Cycle counter where the core has one, otherwise derived from micros()
+static inline uint32_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc();
+#elif defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+    return DWT->CYCCNT;
+#elif defined(F_CPU)
+    return micros() * (F_CPU / 1000000UL);
+#else
+    return 0;
+#endif
+}
+
+void opGetAcceleration() { accel.getAcceleration(&acc); }
+void opRawBurst() { accel.getRawAcceleration(&raw); }
+void opReadFrame() { accel.readFrame(&frame); }
+void opConvert() { accel.convertAcceleration(&raw, &acc); }
+void opPack8() { packSamples(block, 64, MSA300_RES_8_BIT, packed); }
+void opPack12() { packSamples(block, 64, MSA300_RES_12_BIT, packed); }
+void opPack14() { packSamples(block, 64, MSA300_RES_14_BIT, packed); }
+void opUnpack12() { unpackSamples(packed, 64, MSA300_RES_12_BIT, block); }
+void opUnpack14() { unpackSamples(packed, 64, MSA300_RES_14_BIT, block); }
+volatile interrupt_t interrupts;
+void opCheckInterrupts() { interrupts.store(accel.checkInterrupts()); }
+void opConfigure() {
+    accel.setRange(MSA300_RANGE_4_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+    accel.setDataRate(MSA300_DATARATE_500_HZ);
+    accel.setTapThreshold(1000);
+    accel.setTapDuration(MSA300_TAP_DUR_100_MS, 0, 0);
+    accel.setActiveThreshold(200);
+    accel.setActiveDuration(2);
+    accel.setInterruptLatch(MSA300_INT_LATCHED_25_MS);
+    accel.enableSingleTapInterrupt(1);
+    accel.enableActiveInterrupt(MSA300_AXIS_Z, 2);
+}
+
+// Startup: defaults, a stored image the chip already holds (warm reset)
+// and alternating images that always differ (cold start)
+uint8_t images[2][MSA300_IMAGE_SIZE];
+uint16_t beginCount;
+void opBegin() { accel.begin(); }
+void opBeginWarm() { accel.begin(images[0]); }
+void opBeginCold() { accel.begin(images[beginCount++ & 1]); }
+
+void opRoute() {
+    accel.routeInterrupts(MSA300_INT_SRC_SINGLE_TAP | MSA300_INT_SRC_DOUBLE_TAP | MSA300_INT_SRC_FREEFALL,
+                          MSA300_INT_SRC_ACTIVE | MSA300_INT_SRC_NEW_DATA);
+}
+
+bool first = true;
+
+void bench(const char *name, void (*op)()) {
+#if defined(BENCH_SIM)
+    sim.resetCounters();
+#endif
+    uint32_t startCycles = cycles();
+    uint32_t start = micros();
+    for(uint16_t i = 0; i < ITERATIONS; i++) {
+        op();
+    }
+    uint32_t elapsed = micros() - start;
+    uint32_t elapsedCycles = cycles() - startCycles;
+
+    Serial.print(first ? "\n    " : ",\n    ");
+    first = false;
+    Serial.print("{\"name\": \"");
+    Serial.print(name);
+    Serial.print("\", \"iterations\": ");
+    Serial.print(ITERATIONS);
+    Serial.print(", \"ns_per_op\": ");
+    Serial.print(elapsed * 1000.0 / ITERATIONS);
+    Serial.print(", \"cycles_per_op\": ");
+    Serial.print((double)elapsedCycles / ITERATIONS);
+#if defined(BENCH_SIM)
+    Serial.print(", \"transactions_per_op\": ");
+    Serial.print((double)sim.transactions() / ITERATIONS);
+    Serial.print(", \"i2c_bytes_per_op\": ");
+    Serial.print((double)sim.busBytes(true) / ITERATIONS);
+    Serial.print(", \"spi_bytes_per_op\": ");
+    Serial.print((double)sim.busBytes(false) / ITERATIONS);
+#endif
+    Serial.print("}");
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+#if !defined(__x86_64__) && !defined(__i386__) && defined(DWT) && defined(DWT_CTRL_CYCCNTENA_Msk)
+    // The cycle counter is off after reset
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    accel.begin();
+#if defined(BENCH_SIM)
+    // Give the simulated chip a sample to read
+    raw.x = 100; raw.y = -200; raw.z = 16384;
+    sim.feed(&raw);
+#endif
+
+    Serial.print("{\n  \"backend\": \"");
+#if defined(BENCH_HARDWARE_I2C)
+    Serial.print("i2c");
+#elif defined(BENCH_HARDWARE_SPI)
+    Serial.print("spi");
+#else
+    Serial.print("sim");
+#endif
+    Serial.print("\",\n  \"benchmarks\": [");
+
+    bench("getAcceleration", opGetAcceleration);
+    bench("getRawAcceleration", opRawBurst);
+    bench("readFrame", opReadFrame);
+    bench("convertAcceleration", opConvert);
+    bench("packSamples_8bit_64", opPack8);
+    bench("packSamples_12bit_64", opPack12);
+    bench("unpackSamples_12bit_64", opUnpack12);
+    bench("packSamples_14bit_64", opPack14);
+    bench("unpackSamples_14bit_64", opUnpack14);
+    bench("checkInterrupts", opCheckInterrupts);
+    bench("configure", opConfigure);
+    bench("routeInterrupts", opRoute);
+
+    opConfigure();
+    accel.readImage(images[0]);
+    accel.setRange(MSA300_RANGE_8_G);
+    accel.setInterruptLatch(MSA300_INT_NON_LATCHED);
+    accel.disableInterrupt(MSA300_INT_SRC_ALL);
+    accel.setOffset(MSA300_AXIS_Z, 39);
+    accel.readImage(images[1]);
+    bench("begin", opBegin);
+    bench("begin_image_warm", opBeginWarm);
+    bench("begin_image_cold", opBeginCold);
+
+    Serial.println("\n  ]\n}");
+}
+
+void loop() {
+}
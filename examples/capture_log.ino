@@ -0,0 +1,53 @@
+#include <MSA300.h>
+#include <MSA300Buffer.h>
+#include <MSA300Log.h>
+#include <Wire.h>
+
+#define BLOCK_SAMPLES 64
+
+rawAcc_t storage[2 * BLOCK_SAMPLES];
+MSA300Buffer buffer(storage, 2 * BLOCK_SAMPLES);
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+
+// Write the capture as binary to the serial port
+MSA300LogWriter logWriter(Serial);
+
+uint32_t blockStart = 0;
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        while(1);
+    }
+
+    // Set measurement range from to +/- 4g
+    accel.setRange(MSA300_RANGE_4_G);
+
+    // Set datarate to 250 Hz
+    accel.setDataRate(MSA300_DATARATE_250_HZ);
+
+    // Write capture header with current configuration
+    logWriter.begin(accel, BLOCK_SAMPLES);
+}
+
+void loop() {
+
+    //Fetch raw sample
+    rawAcc_t sample;
+    accel.getRawAcceleration(&sample);
+
+    if(buffer.available() == 0) {
+        blockStart = micros();
+    }
+    buffer.push(&sample);
+
+    //Write a block once it is full
+    logWriter.write(buffer, blockStart);
+
+    delay(4);
+}
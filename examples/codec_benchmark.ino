@@ -0,0 +1,113 @@
+#include <MSA300.h>
+#include <MSA300Codec.h>
+#include <Wire.h>
+#if defined(__linux__)
+#include <MSA300Log.h>
+#include <stdlib.h>
+#endif
+
+#define TRACE_SAMPLES 512
+#define FRAME_SAMPLES 32
+
+rawAcc_t trace[TRACE_SAMPLES];
+uint8_t frame[MSA300_CODEC_MAX_FRAME(FRAME_SAMPLES)];
+MSA300Encoder encoder(frame, sizeof(frame), FRAME_SAMPLES);
+rawAcc_t decoded[FRAME_SAMPLES];
+MSA300Decoder decoder(decoded, FRAME_SAMPLES);
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+
+uint16_t recordTrace() {
+#if defined(__linux__)
+    // On a host, replay a recorded capture given in MSA300_TRACE
+    const char *path = getenv("MSA300_TRACE");
+    MSA300LogReader reader;
+    if(path && reader.open(path)) {
+        uint16_t count = 0;
+        msa300LogSpan_t span;
+        for(size_t b = 0; b < reader.blockCount() && count < TRACE_SAMPLES; b++) {
+            reader.block(b, &span);
+            for(uint16_t i = 0; i < span.count && count < TRACE_SAMPLES; i++) {
+                trace[count++] = span.samples[i];
+            }
+        }
+        return count;
+    }
+#endif
+
+    // Otherwise record a live trace at 1 kHz
+    for(uint16_t i = 0; i < TRACE_SAMPLES; i++) {
+        accel.getRawAcceleration(&trace[i]);
+        delayMicroseconds(1000);
+    }
+    return TRACE_SAMPLES;
+}
+
+// Encode the first samples of the trace into one partial frame, as
+// finish() closes the tail of a stream, and decode it again
+bool checkPartialFrame(uint16_t samples) {
+    uint8_t count = samples < FRAME_SAMPLES ? samples : FRAME_SAMPLES - 1;
+
+    encoder.begin(MSA300_RES_14_BIT);
+    for(uint8_t i = 0; i < count; i++) {
+        encoder.push(&trace[i]);
+    }
+    uint16_t size = encoder.finish();
+
+    decoder.reset();
+    uint8_t result = 0;
+    for(uint16_t i = 0; i < size; i++) {
+        result = decoder.push(frame[i]);
+    }
+    if(result != count) {
+        return false;
+    }
+
+    // Bits below 14-bit resolution are not transmitted
+    for(uint8_t i = 0; i < count; i++) {
+        if(decoded[i].x != (trace[i].x & ~3) || decoded[i].y != (trace[i].y & ~3) ||
+           decoded[i].z != (trace[i].z & ~3)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    uint16_t samples = recordTrace();
+
+    // Encode the whole trace and measure time spent
+    uint32_t bytes = 0;
+    encoder.begin(MSA300_RES_14_BIT);
+    uint32_t start = micros();
+    for(uint16_t i = 0; i < samples; i++) {
+        bytes += encoder.push(&trace[i]);
+    }
+    bytes += encoder.finish();
+    uint32_t elapsed = micros() - start;
+
+    Serial.print("Samples: ");
+    Serial.println(samples);
+    Serial.print("Compression ratio: ");
+    Serial.println((float)samples * sizeof(rawAcc_t) / bytes);
+    Serial.print("Encode us per sample: ");
+    Serial.println((float)elapsed / samples);
+#if defined(F_CPU)
+    Serial.print("Encode cycles per sample: ");
+    Serial.println((float)elapsed * (F_CPU / 1000000UL) / samples);
+#endif
+    Serial.print("Partial frame round trip: ");
+    Serial.println(checkPartialFrame(samples) ? "ok" : "FAILED");
+}
+
+void loop() {
+}
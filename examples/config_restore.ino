@@ -0,0 +1,66 @@
+// Stores the sensor configuration and calibration in EEPROM on the first
+// boot and restores it on every later boot, which skips the setter
+// sequence and the calibration. Send 'c' to forget the configuration.
+#include <Wire.h>
+#include <EEPROM.h>
+#include <MSA300.h>
+#include <MSA300Config.h>
+
+MSA300 accel = MSA300(1234);
+MSA300Config config(accel);
+MSA300EepromStorage storage(0);
+
+void configure() {
+    accel.begin();
+    accel.setRange(MSA300_RANGE_4_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+    accel.setDataRate(MSA300_DATARATE_125_HZ);
+    accel.setTapDuration(MSA300_TAP_DUR_100_MS, 0, 0);
+    accel.setTapThreshold(1000);
+    accel.setInterruptLatch(MSA300_INT_LATCHED_50_MS);
+    accel.enableSingleTapInterrupt(1);
+
+    // Board lies flat, Z up
+    Serial.print("Calibration residual: ");
+    Serial.print(accel.calibrate(MSA300_AXIS_Z));
+    Serial.println(" mg");
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    uint32_t start = micros();
+    if(config.load(storage) && config.restore()) {
+        Serial.print("Restored in ");
+        Serial.print(micros() - start);
+        Serial.println(" us");
+    } else {
+        configure();
+        Serial.print("Configured in ");
+        Serial.print(micros() - start);
+        Serial.println(" us");
+
+        config.capture();
+        Serial.println(config.save(storage) ? "Saved" : "Save failed");
+    }
+}
+
+void loop() {
+
+    if(Serial.read() == 'c') {
+        EEPROM.write(0, 0xFF);
+        Serial.println("Configuration cleared");
+    }
+
+    acc_t result;
+    accel.getAcceleration(&result);
+    Serial.print("X: ");
+    Serial.print(result.x);
+    Serial.print(" Y: ");
+    Serial.print(result.y);
+    Serial.print(" Z: ");
+    Serial.println(result.z);
+
+    delay(500);
+}
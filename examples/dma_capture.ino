@@ -0,0 +1,56 @@
+// Block capture through a DMA port. Runs on the simulated port, so the
+// capture logic can be checked on a host. On hardware, replace
+// MSA300SimDma with a port for the MCU and drop the feed loop.
+#include <MSA300.h>
+#include <MSA300Sim.h>
+#include <MSA300Capture.h>
+
+const uint16_t block_samples = 64;
+const uint8_t blocks = 4;
+
+MSA300Sim sim;
+MSA300 accel = MSA300(sim, 1234);
+MSA300SimDma dma(sim, 1);
+rawAcc_t storage[block_samples * blocks];
+MSA300Capture capture(accel, dma, storage, block_samples, blocks);
+
+void setup() {
+
+    Serial.begin(115200);
+
+    accel.begin();
+    accel.setDataRate(MSA300_DATARATE_1000_HZ);
+
+    if(!capture.begin(1)) {
+        Serial.println("Capture failed to start");
+        return;
+    }
+
+    // One second of samples, the DMA reads each one without the CPU
+    uint32_t samples = 0;
+    sim.resetCounters();
+    for(uint16_t i = 0; i < 1000; i++) {
+        rawAcc_t sample = {0, 0, 4096};
+        sim.feed(&sample);
+        dma.service();
+
+        // Main loop work, only a completed block needs attention
+        while(capture.available()) {
+            // Process capture.block() here
+            samples += capture.blockSamples();
+            capture.release();
+        }
+    }
+
+    Serial.print("Samples: ");
+    Serial.println(samples);
+    Serial.print("CPU wakeups: ");
+    Serial.println(dma.wakeups());
+    Serial.print("Overruns: ");
+    Serial.println(capture.overruns());
+
+    capture.end();
+}
+
+void loop() {
+}
@@ -0,0 +1,84 @@
+#include <MSA300.h>
+#include <MSA300Buffer.h>
+#include <MSA300Drop.h>
+#include <Wire.h>
+
+const byte interrupt_pin = 2;
+volatile bool falling = false;
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+
+// The recorder counts history entries as output periods, so read once
+// per period: 125 Hz while armed, 1000 Hz while recording
+const uint32_t armed_period = 8000;
+const uint32_t recording_period = 1000;
+uint32_t next_sample = 0;
+
+// Room for the pre-trigger history and about one second at 1000 Hz
+rawAcc_t storage[1024];
+MSA300Buffer window(storage, 1024);
+MSA300DropRecorder recorder(accel, window);
+
+void setup() {
+
+    Serial.begin(115200);
+
+    //Setup interrupt
+    pinMode(interrupt_pin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(interrupt_pin), isr, RISING);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    accel.setRange(MSA300_RANGE_16_G);
+    accel.setDataRate(MSA300_DATARATE_125_HZ);
+    accel.setFreefallThreshold(375);
+    accel.setFreefallDuration(20);
+    accel.setInterruptLatch(MSA300_INT_NON_LATCHED);
+
+    // Flag impacts above 4 g, at rest within 150 mg for 200 ms
+    recorder.begin(1, 4000, 150, 200, 32);
+}
+
+void loop() {
+
+    if(falling) {
+        falling = false;
+        recorder.trigger(micros());
+        next_sample = micros();
+    }
+
+    uint32_t now = micros();
+    if((int32_t)(now - next_sample) < 0) {
+        return;
+    }
+    uint32_t period = recorder.busy() ? recording_period : armed_period;
+    next_sample += period;
+    if((int32_t)(now - next_sample) >= 0) {
+        next_sample = now + period;
+    }
+
+    rawAcc_t sample;
+    accel.getRawAcceleration(&sample);
+
+    if(recorder.update(&sample, now)) {
+        const dropEvent_t *event = recorder.event();
+
+        Serial.print("Fall: ");
+        Serial.print(event->fallTime);
+        Serial.print(" ms, peak: ");
+        Serial.print(event->peak);
+        Serial.print(" mg, rest after: ");
+        Serial.print(event->restTime);
+        Serial.println(" ms");
+
+        recorder.arm();
+    }
+}
+
+void isr() {
+    falling = true;
+}
@@ -0,0 +1,66 @@
+#include <MSA300.h>
+#include <MSA300Dispatch.h>
+#include <Wire.h>
+
+const byte interrupt_pin = 2;
+volatile bool pending = false;
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+MSA300Dispatcher dispatcher;
+
+void onSingleTap(const interrupt_t &interrupts, void *context) {
+    Serial.println("Single tap");
+}
+
+void onDoubleTap(const interrupt_t &interrupts, void *context) {
+    Serial.println("Double tap");
+}
+
+void onFreefall(const interrupt_t &interrupts, void *context) {
+    Serial.println("Freefall");
+}
+
+void setup() {
+
+    Serial.begin(9600);
+
+    //Setup interrupt
+    pinMode(interrupt_pin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(interrupt_pin), isr, RISING);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    accel.setRange(MSA300_RANGE_16_G);
+    accel.setTapThreshold(2000);
+    accel.setTapDuration(MSA300_TAP_DUR_250_MS, 0, 0);
+    accel.setFreefallThreshold(375);
+    accel.setFreefallDuration(20);
+
+    // Latch until serviced, so nothing is lost between the edge and the read
+    accel.setInterruptLatch(MSA300_INT_LATCHED);
+    accel.enableSingleTapInterrupt(1);
+    accel.enableDoubleTapInterrupt(1);
+    accel.enableFreefallInterrupt(1);
+
+    dispatcher.on(MSA300_EVENT_SINGLE_TAP, onSingleTap);
+    dispatcher.on(MSA300_EVENT_DOUBLE_TAP, onDoubleTap);
+    dispatcher.on(MSA300_EVENT_FREEFALL, onFreefall);
+}
+
+void loop() {
+
+    if(pending) {
+        pending = false;
+
+        // One status read, only registered handlers run, latch is reset
+        dispatcher.service(accel);
+    }
+}
+
+void isr() {
+    pending = true;
+}
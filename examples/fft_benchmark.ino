@@ -0,0 +1,139 @@
+// Times the fixed-point spectrum against a float FFT of the same block
+// and prints the results as JSON. The input is a synthetic vibration
+// (50 Hz and 120 Hz on top of 1 g), so no sensor is needed.
+#include <MSA300.h>
+#include <MSA300Spectrum.h>
+#include <math.h>
+
+#define ITERATIONS 100
+#define SAMPLE_RATE 1000.0f
+
+rawAcc_t block[MSA300_FFT_MAX_SIZE];
+int16_t workspace[MSA300_SPECTRUM_WORKSPACE(MSA300_FFT_MAX_SIZE)];
+uint16_t bins[MSA300_SPECTRUM_BINS(MSA300_FFT_MAX_SIZE)];
+MSA300Spectrum spectrum(workspace, MSA300_SPECTRUM_WORKSPACE(MSA300_FFT_MAX_SIZE));
+
+float floatRe[MSA300_FFT_MAX_SIZE];
+float floatIm[MSA300_FFT_MAX_SIZE];
+float floatBins[MSA300_SPECTRUM_BINS(MSA300_FFT_MAX_SIZE)];
+
+// Textbook path: convert to g, window, complex radix-2 FFT in float
+void floatSpectrum(uint16_t size) {
+    float mean = 0;
+    for(uint16_t n = 0; n < size; n++) {
+        floatRe[n] = block[n].z * (4.0f / 65536.0f);
+        mean += floatRe[n];
+    }
+    mean /= size;
+
+    for(uint16_t n = 0, j = 0; n < size; n++) {
+        if(n < j) {
+            float t = floatRe[n]; floatRe[n] = floatRe[j]; floatRe[j] = t;
+        }
+        uint16_t bit = size >> 1;
+        for(; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+    }
+    for(uint16_t n = 0; n < size; n++) {
+        uint16_t k = 0;
+        for(uint16_t b = 1, v = n; b < size; b <<= 1, v >>= 1) {
+            k = (k << 1) | (v & 1);
+        }
+        floatRe[n] = (floatRe[n] - mean) * (0.5f - 0.5f * cosf(2 * M_PI * k / size));
+        floatIm[n] = 0;
+    }
+
+    for(uint16_t h = 1; h < size; h <<= 1) {
+        for(uint16_t j = 0; j < h; j++) {
+            float c = cosf(M_PI * j / h);
+            float s = sinf(M_PI * j / h);
+            for(uint16_t p = j; p < size; p += 2 * h) {
+                uint16_t q = p + h;
+                float tr = floatRe[q] * c + floatIm[q] * s;
+                float ti = floatIm[q] * c - floatRe[q] * s;
+                floatRe[q] = floatRe[p] - tr;
+                floatIm[q] = floatIm[p] - ti;
+                floatRe[p] += tr;
+                floatIm[p] += ti;
+            }
+        }
+    }
+
+    for(uint16_t k = 0; k <= size / 2; k++) {
+        floatBins[k] = 4000.0f * sqrtf(floatRe[k] * floatRe[k] + floatIm[k] * floatIm[k]) / size;
+    }
+}
+
+bool first = true;
+
+void bench(uint16_t size) {
+    spectrum_t result;
+    result.bins = bins;
+    spectrum.begin(size, SAMPLE_RATE, MSA300_RANGE_2_G);
+
+    uint32_t start = micros();
+    for(uint16_t i = 0; i < ITERATIONS; i++) {
+        spectrum.compute(block, MSA300_AXIS_Z, &result);
+    }
+    uint32_t fixedTime = micros() - start;
+
+    start = micros();
+    for(uint16_t i = 0; i < ITERATIONS; i++) {
+        floatSpectrum(size);
+    }
+    uint32_t floatTime = micros() - start;
+
+    // Largest amplitude difference relative to the largest bin
+    float error = 0;
+    float largest = 0;
+    for(uint16_t k = 0; k < result.count; k++) {
+        float difference = fabsf(result.bins[k] * result.scale - floatBins[k]);
+        error = difference > error ? difference : error;
+        largest = floatBins[k] > largest ? floatBins[k] : largest;
+    }
+
+    peak_t peaks[2];
+    MSA300Spectrum::findPeaks(&result, peaks, 2);
+
+    Serial.print(first ? "\n    " : ",\n    ");
+    first = false;
+    Serial.print("{\"size\": ");
+    Serial.print(size);
+    Serial.print(", \"fixed_us\": ");
+    Serial.print((float)fixedTime / ITERATIONS);
+    Serial.print(", \"float_us\": ");
+    Serial.print((float)floatTime / ITERATIONS);
+    Serial.print(", \"max_error_db\": ");
+    Serial.print(20 * log10f(error / largest));
+    Serial.print(", \"peak_hz\": ");
+    Serial.print(peaks[0].frequency);
+    Serial.print(", \"peak_mg\": ");
+    Serial.print(peaks[0].amplitude);
+    Serial.print(", \"rms_mg\": ");
+    Serial.print(MSA300Spectrum::bandRms(&result, 0, SAMPLE_RATE / 2));
+    Serial.print("}");
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // 1 g + 100 mg at 50 Hz + 30 mg at 120 Hz, 14 bits in the 2 g range
+    for(uint16_t n = 0; n < MSA300_FFT_MAX_SIZE; n++) {
+        float mg = 1000 + 100 * sinf(2 * M_PI * 50 * n / SAMPLE_RATE) + 30 * sinf(2 * M_PI * 120 * n / SAMPLE_RATE);
+        block[n].x = 0;
+        block[n].y = 0;
+        block[n].z = (int16_t)(mg * 65536.0f / 4000.0f) & ~0x3;
+    }
+
+    Serial.print("{\n  \"benchmarks\": [");
+    for(uint16_t size = MSA300_FFT_MIN_SIZE; size <= MSA300_FFT_MAX_SIZE; size <<= 1) {
+        bench(size);
+    }
+    Serial.println("\n  ]\n}");
+}
+
+void loop() {
+}
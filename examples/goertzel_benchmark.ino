@@ -0,0 +1,100 @@
+// Times the Goertzel bank against the fixed-point spectrum for the same
+// window and prints the results as JSON, so the cheaper path can be
+// picked per deployment. The input is a synthetic vibration (50 Hz and
+// 120 Hz on top of 1 g), so no sensor is needed.
+#include <MSA300.h>
+#include <MSA300Goertzel.h>
+#include <MSA300Spectrum.h>
+#include <math.h>
+
+#define ITERATIONS 20
+#define WINDOW 1024
+#define DATA_RATE MSA300_DATARATE_1000_HZ
+
+// Machine frequencies to track, in Hz
+const float tones[MSA300_GOERTZEL_MAX_TONES] = {50, 120, 25, 100, 150, 200, 240, 300};
+
+rawAcc_t block[WINDOW];
+int16_t workspace[MSA300_SPECTRUM_WORKSPACE(WINDOW)];
+uint16_t bins[MSA300_SPECTRUM_BINS(WINDOW)];
+MSA300Spectrum spectrum(workspace, MSA300_SPECTRUM_WORKSPACE(WINDOW));
+MSA300Goertzel goertzel;
+
+bool first = true;
+
+void bench(uint8_t count) {
+    goertzel.clearTones();
+    for(uint8_t i = 0; i < count; i++) {
+        goertzel.addTone(tones[i], MSA300_AXIS_Z);
+    }
+
+    uint32_t start = micros();
+    for(uint16_t i = 0; i < ITERATIONS; i++) {
+        for(uint16_t used = 0; used < WINDOW; ) {
+            used += goertzel.update(&block[used], WINDOW - used);
+        }
+    }
+    uint32_t goertzelTime = micros() - start;
+
+    // Equivalent FFT path: full spectrum, then read the bin of each tone
+    spectrum_t result;
+    result.bins = bins;
+    float amplitudes[MSA300_GOERTZEL_MAX_TONES];
+    start = micros();
+    for(uint16_t i = 0; i < ITERATIONS; i++) {
+        spectrum.compute(block, MSA300_AXIS_Z, &result);
+        for(uint8_t t = 0; t < count; t++) {
+            uint16_t bin = (uint16_t)(tones[t] / result.binHz + 0.5f);
+            amplitudes[t] = result.bins[bin] * result.scale;
+        }
+    }
+    uint32_t fftTime = micros() - start;
+
+    Serial.print(first ? "\n    " : ",\n    ");
+    first = false;
+    Serial.print("{\"tones\": ");
+    Serial.print(count);
+    Serial.print(", \"goertzel_us\": ");
+    Serial.print((float)goertzelTime / ITERATIONS);
+    Serial.print(", \"fft_us\": ");
+    Serial.print((float)fftTime / ITERATIONS);
+    Serial.print(", \"goertzel_mg\": [");
+    for(uint8_t t = 0; t < count; t++) {
+        Serial.print(t ? ", " : "");
+        Serial.print(goertzel.amplitude(t));
+    }
+    Serial.print("], \"fft_mg\": [");
+    for(uint8_t t = 0; t < count; t++) {
+        Serial.print(t ? ", " : "");
+        Serial.print(amplitudes[t]);
+    }
+    Serial.print("]}");
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // 1 g + 100 mg at 50 Hz + 30 mg at 120 Hz, 14 bits in the 2 g range
+    float rate = dataRateToHz(DATA_RATE);
+    for(uint16_t n = 0; n < WINDOW; n++) {
+        float mg = 1000 + 100 * sinf(2 * M_PI * 50 * n / rate) + 30 * sinf(2 * M_PI * 120 * n / rate);
+        block[n].x = 0;
+        block[n].y = 0;
+        block[n].z = (int16_t)(mg * 65536.0f / 4000.0f) & ~0x3;
+    }
+
+    goertzel.begin(WINDOW, DATA_RATE, MSA300_RANGE_2_G, MSA300_RES_14_BIT);
+    spectrum.begin(WINDOW, rate, MSA300_RANGE_2_G);
+
+    Serial.print("{\n  \"window\": ");
+    Serial.print(WINDOW);
+    Serial.print(",\n  \"benchmarks\": [");
+    for(uint8_t count = 1; count <= MSA300_GOERTZEL_MAX_TONES; count <<= 1) {
+        bench(count);
+    }
+    Serial.println("\n  ]\n}");
+}
+
+void loop() {
+}
@@ -0,0 +1,59 @@
+#include <MSA300.h>
+#include <MSA300Dispatch.h>
+#include <MSA300Poll.h>
+#include <Wire.h>
+
+// Poll every 100 ms, the latch holds events for two periods so a late
+// poll still sees them
+const uint32_t poll_period = 100;
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+MSA300Dispatcher dispatcher;
+MSA300Poller poller(accel, &dispatcher);
+
+void onSingleTap(const interrupt_t &interrupts, void *context) {
+    Serial.println("Single tap");
+}
+
+void onActive(const interrupt_t &interrupts, void *context) {
+    Serial.println("Active");
+}
+
+void setup() {
+
+    Serial.begin(9600);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    accel.setRange(MSA300_RANGE_4_G);
+    accel.setTapThreshold(2000);
+    accel.setTapDuration(MSA300_TAP_DUR_250_MS, 0, 0);
+    accel.setActiveThreshold(500);
+    accel.setActiveDuration(2);
+
+    // Engines run on the chip, no INT pin has to be wired
+    accel.enableSingleTapInterrupt(1);
+    accel.enableActiveInterrupt(MSA300_AXIS_Z, 1);
+
+    dispatcher.on(MSA300_EVENT_SINGLE_TAP, onSingleTap);
+    dispatcher.on(MSA300_EVENT_ACTIVE, onActive);
+
+    poller.begin(poll_period);
+
+    busLoad_t load = MSA300Poller::estimateBusLoad(1000.0 / poll_period, 100000, true);
+    Serial.print("Bus load: ");
+    Serial.print(load.bytesPerSecond);
+    Serial.print(" B/s, ");
+    Serial.print(load.utilization * 100);
+    Serial.println(" %");
+}
+
+void loop() {
+
+    // One status read per period, latch is reset only when something fired
+    poller.poll(millis());
+}
@@ -0,0 +1,63 @@
+// Lets the driver choose power mode, data rate and bandwidth. State the
+// signal bandwidth the application needs and the noise it can live with,
+// optimizePower() picks the configuration with the lowest estimated
+// current and writes it in one burst.
+#include <MSA300.h>
+#include <Wire.h>
+
+MSA300 accel = MSA300(1234);
+
+const char *modes[] = {"normal", "low power", "", "suspend"};
+
+void printConfig(const powerConfig_t &config) {
+    Serial.print("Mode: ");
+    Serial.print(modes[config.mode]);
+    Serial.print(" ODR: ");
+    Serial.print(dataRateToHz(config.dataRate));
+    Serial.print(" Hz Bandwidth: ");
+    Serial.print(config.bandwidthHz);
+    Serial.print(" Hz Noise: ");
+    Serial.print(config.noiseMg);
+    Serial.print(" mg Current: ");
+    Serial.print(config.currentUa);
+    Serial.println(" uA");
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected");
+        while(1);
+    }
+
+    accel.setRange(MSA300_RANGE_2_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+
+    // What begin() sets up: 1000 Hz in normal mode
+    powerConfig_t config;
+    accel.estimatePower(MSA300_MODE_NORMAL, MSA300_DATARATE_1000_HZ, MSA300_BW_500_HZ, &config);
+    Serial.print("Default   ");
+    printConfig(config);
+
+    // Posture tracking: 5 Hz of motion, 10 mg rms is plenty
+    if(!accel.optimizePower(5, 10, &config)) {
+        Serial.println("No configuration fits");
+        while(1);
+    }
+    Serial.print("Optimized ");
+    printConfig(config);
+}
+
+void loop() {
+    acc_t acc;
+    accel.getAcceleration(&acc);
+
+    Serial.print("X: "); Serial.print(acc.x); Serial.print("  ");
+    Serial.print("Y: "); Serial.print(acc.y); Serial.print("  ");
+    Serial.print("Z: "); Serial.print(acc.z); Serial.print("  ");
+    Serial.println("m/s^2 ");
+
+    delay(500);
+}
@@ -0,0 +1,56 @@
+// Host-only example: sweeps the tap threshold over a recorded capture.
+// Build with a Linux Arduino emulation layer and set MSA300_TRACE to a
+// capture written by capture_log.ino.
+#include <MSA300.h>
+#include <MSA300Sim.h>
+#include <MSA300Replay.h>
+#include <stdlib.h>
+
+MSA300Sim sim;
+MSA300 accel = MSA300(sim, 1234);
+MSA300Replay replay(accel, sim);
+MSA300LogReader reader;
+
+uint32_t taps = 0;
+
+void onEvent(uint32_t time, const interrupt_t &interrupts, void *context) {
+    if(interrupts.sTapInt()) {
+        taps++;
+    }
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    const char *path = getenv("MSA300_TRACE");
+    if(!path || !reader.open(path)) {
+        Serial.println("Set MSA300_TRACE to a capture file");
+        return;
+    }
+
+    accel.begin();
+    replay.configure(reader.header());
+    replay.onEvent(onEvent, NULL);
+
+    // Same interrupt setup as tap_interrupt.ino
+    accel.setTapDuration(MSA300_TAP_DUR_100_MS, 0, 0);
+    accel.setInterruptLatch(MSA300_INT_NON_LATCHED);
+    accel.enableSingleTapInterrupt(1);
+
+    for(float threshold = 250; threshold <= 2000; threshold += 250) {
+        accel.setTapThreshold(threshold);
+        taps = 0;
+        replay.reset();
+        replay.run(reader);
+
+        Serial.print("Threshold ");
+        Serial.print(threshold);
+        Serial.print(" mg: ");
+        Serial.print(taps);
+        Serial.println(" taps");
+    }
+}
+
+void loop() {
+}
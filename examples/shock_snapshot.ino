@@ -0,0 +1,76 @@
+#include <MSA300.h>
+#include <MSA300Dispatch.h>
+#include <MSA300Snapshot.h>
+#include <Wire.h>
+
+const uint16_t pre_samples = 250;
+const uint16_t post_samples = 250;
+const uint8_t buffers = 2;
+
+// One snapshot sample per output period at 500 Hz
+const uint32_t sample_period = 2000;
+uint32_t next_sample = 0;
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+
+// 6 KB of samples, too much for 2 KB AVR boards such as the Uno. Shrink
+// pre_samples and post_samples there.
+rawAcc_t storage[buffers * (pre_samples + post_samples)];
+MSA300Snapshot snapshots(storage, pre_samples, post_samples, buffers);
+uint16_t uploaded = 0;
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    accel.setRange(MSA300_RANGE_16_G);
+    accel.setDataRate(MSA300_DATARATE_500_HZ);
+    accel.setActiveThreshold(1000);
+    accel.setActiveDuration(1);
+    accel.setInterruptLatch(MSA300_INT_LATCHED_25_MS);
+    accel.enableInterrupt(MSA300_INT_SRC_ACTIVE | MSA300_INT_SRC_FREEFALL, 1);
+
+    // Snapshot on chip activity or freefall, or on anything above 6 g
+    snapshots.setTriggers((1 << MSA300_EVENT_ACTIVE) | (1 << MSA300_EVENT_FREEFALL));
+    snapshots.setThreshold(6000, MSA300_RANGE_16_G);
+}
+
+void loop() {
+
+    // Reading faster than the data rate would record the same sample twice
+    uint32_t now = micros();
+    if((int32_t)(now - next_sample) >= 0) {
+        next_sample += sample_period;
+        if((int32_t)(now - next_sample) >= 0) {
+            next_sample = now + sample_period;
+        }
+
+        frame_t frame;
+        accel.readFrame(&frame);
+
+        snapshots.trigger(frame.interrupts);
+        snapshots.update(&frame.acc);
+    }
+
+    // Upload one sample per loop, recording goes on in the other buffer
+    const snapshot_t *snapshot = snapshots.snapshot();
+    if(snapshot) {
+        const rawAcc_t &sample = snapshot->at(uploaded);
+        Serial.print(sample.x);
+        Serial.print(',');
+        Serial.print(sample.y);
+        Serial.print(',');
+        Serial.println(sample.z);
+
+        if(++uploaded == snapshot->count) {
+            uploaded = 0;
+            snapshots.release();
+        }
+    }
+}
@@ -0,0 +1,80 @@
+// Six-position calibration. Place the board on a level surface with each
+// axis pointing up and down in turn, and press enter in the serial
+// monitor after each move. The coefficients are printed as a hex blob
+// for the factory database, then every reading is corrected with them.
+#include <Wire.h>
+#include <MSA300.h>
+#include <MSA300Calibration.h>
+
+MSA300 accel = MSA300(1234);
+MSA300Calibration calibration(accel);
+MSA300Correction correction;
+
+const char *positions[] = {"X up", "X down", "Y up", "Y down", "Z up", "Z down"};
+
+void waitForEnter() {
+    while(Serial.read() != '\n') {
+    }
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected");
+        while(1);
+    }
+    accel.setRange(MSA300_RANGE_2_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+    accel.setDataRate(MSA300_DATARATE_125_HZ);
+
+    calibration.begin();
+    for(uint8_t p = 0; p < 6; p++) {
+        Serial.print("Place the board ");
+        Serial.print(positions[p]);
+        Serial.println(" and press enter");
+        waitForEnter();
+        calibration.collect((position_t)p, 250);
+    }
+
+    calibration_t coefficients;
+    float residual;
+    if(!calibration.solve(&coefficients, &residual)) {
+        Serial.println("Calibration failed, check the positions");
+        while(1);
+    }
+    Serial.print("Residual: ");
+    Serial.print(residual);
+    Serial.println(" mg");
+
+    uint8_t blob[MSA300_CALIBRATION_BLOB_SIZE];
+    uint16_t size = MSA300Calibration::serialize(&coefficients, blob, sizeof(blob));
+    for(uint16_t i = 0; i < size; i++) {
+        if(blob[i] < 0x10) {
+            Serial.print('0');
+        }
+        Serial.print(blob[i], HEX);
+    }
+    Serial.println();
+
+    correction.begin(&coefficients, accel.getRange());
+}
+
+void loop() {
+
+    rawAcc_t sample;
+    accel.getRawAcceleration(&sample);
+    correction.apply(&sample, &sample, 1);
+
+    acc_t result;
+    accel.convertAcceleration(&sample, &result);
+    Serial.print("X: ");
+    Serial.print(result.x);
+    Serial.print(" Y: ");
+    Serial.print(result.y);
+    Serial.print(" Z: ");
+    Serial.println(result.z);
+
+    delay(500);
+}
@@ -31,7 +31,7 @@ void setup() {
     accel.setDataRate(MSA300_DATARATE_500_HZ);
 
     // Set tap threshold to 2g
-    accel.setTapThreshold(2000f);
+    accel.setTapThreshold(2000);
 
     // Set tap interrupt duration to 100 ms, quiet to  30 ms and shock to 50 ms
     accel.setTapDuration(MSA300_TAP_DUR_100_MS, 0, 0);
@@ -49,26 +49,29 @@ void loop() {
 
     
 
-    if(interrupts.sTapInt) {
+    interrupt_t events = interrupts.load();
+
+    if(events.sTapInt()) {
 
         Serial.print("Number of taps: ");
-        Serial.printnln(++counter);
+        Serial.println(++counter);
         
         //Check the sign of tap
-        uint8_t sign = interrupts.intStatus.tapSign;
+        uint8_t sign = events.tapSign();
         Serial.print("Sign of tap is: ");
         Serial.println(sign ? '+' : '-');
         
         //Check the axis that triggered tap interrupt
-        if(interrupts.intStatus.tapFirstX) {
+        if(events.tapFirstX()) {
             Serial.println("Tap triggered by x-axis");
-        } else if (interrupts.intStatus.tapFirstY) {
+        } else if (events.tapFirstY()) {
             Serial.println("Tap triggered by y-axis");
-        } else if (interrupts.intStatus.tapFirstZ) {
+        } else if (events.tapFirstZ()) {
             Serial.println("Tap triggered by z-axis");
         }
 
         //Reset interrupts
+        interrupts.store(interrupt_t());
         accel.resetInterrupt();
     }
  
@@ -76,5 +79,5 @@ void loop() {
 
 void tap() {
     //Check if tap interrupt has occured
-    interrupts = accel.checkInterrupts();
+    interrupts.store(accel.checkInterrupts());
 }
\ No newline at end of file
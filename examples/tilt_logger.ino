@@ -0,0 +1,66 @@
+// Logs the tilt of a slowly moving object on a small battery. The sensor
+// sleeps in suspend mode and wakes every 10 s for a burst of 32 samples
+// at 125 Hz, the mean of the burst is printed together with the
+// estimated average sensor current.
+#include <MSA300.h>
+#include <MSA300Buffer.h>
+#include <MSA300Duty.h>
+#include <Wire.h>
+#include <math.h>
+
+#define PERIOD_MS 10000
+#define BURST 32
+
+MSA300 accel = MSA300(1234);
+rawAcc_t storage[BURST];
+MSA300Buffer buffer(storage, BURST);
+MSA300DutyCycle duty(accel, buffer);
+
+void setup() {
+
+    Serial.begin(115200);
+
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected");
+        while(1);
+    }
+
+    accel.setRange(MSA300_RANGE_2_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+    accel.setDataRate(MSA300_DATARATE_125_HZ);
+
+    if(!duty.begin(PERIOD_MS, BURST, micros())) {
+        Serial.println("Burst does not fit in the period");
+        while(1);
+    }
+}
+
+void loop() {
+
+    if(!duty.update(micros())) {
+        // A low power core would sleep for duty.nextEvent(micros()) here
+        return;
+    }
+
+    int32_t sum[3] = {0, 0, 0};
+    uint16_t count = 0;
+    rawAcc_t sample;
+    while(buffer.pop(&sample)) {
+        sum[0] += sample.x;
+        sum[1] += sample.y;
+        sum[2] += sample.z;
+        count++;
+    }
+
+    float x = (float)sum[0] / count;
+    float y = (float)sum[1] / count;
+    float z = (float)sum[2] / count;
+
+    Serial.print("Pitch: ");
+    Serial.print(atan2(x, sqrt(y * y + z * z)) * 180.0 / M_PI);
+    Serial.print(" Roll: ");
+    Serial.print(atan2(y, z) * 180.0 / M_PI);
+    Serial.print(" Average current: ");
+    Serial.print(duty.averageCurrent());
+    Serial.println(" uA");
+}
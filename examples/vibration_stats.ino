@@ -0,0 +1,64 @@
+#include <MSA300.h>
+#include <MSA300Stats.h>
+#include <Wire.h>
+
+// One second windows of 8 sub-blocks of 125 samples at 1000 Hz,
+// sliding by a quarter second
+const uint16_t block_samples = 125;
+const uint8_t window_blocks = 8;
+const uint8_t hop_blocks = 2;
+
+// Initialize MSA300 with ID using i2c
+MSA300 accel = MSA300(1234);
+
+statsBlock_t blocks[window_blocks];
+MSA300Stats stats(blocks, window_blocks);
+
+void printAxis(const char *name, const axisStats_t &axis) {
+    Serial.print(name);
+    Serial.print(" rms: ");
+    Serial.print(axis.rms);
+    Serial.print(" mg, peak: ");
+    Serial.print(axis.peak);
+    Serial.print(" mg, crest: ");
+    Serial.print(axis.crest);
+    Serial.print(", kurtosis: ");
+    Serial.println(axis.kurtosis);
+}
+
+void setup() {
+
+    Serial.begin(115200);
+
+    // Establish connection to sensor
+    if(!accel.begin()) {
+        Serial.println("No MSA300 detected!");
+    }
+
+    accel.setRange(MSA300_RANGE_4_G);
+    accel.setResolution(MSA300_RES_14_BIT);
+    accel.setDataRate(MSA300_DATARATE_1000_HZ);
+
+    stats.begin(block_samples, window_blocks, hop_blocks, MSA300_RANGE_4_G, MSA300_RES_14_BIT);
+}
+
+void loop() {
+
+    rawAcc_t sample;
+    accel.getRawAcceleration(&sample);
+
+    // Only the summary of each window leaves the node
+    if(stats.update(&sample)) {
+        const stats_t *result = stats.result();
+        printAxis("X", result->axis[0]);
+        printAxis("Y", result->axis[1]);
+        printAxis("Z", result->axis[2]);
+        Serial.print("Vector rms: ");
+        Serial.print(result->rms);
+        Serial.print(" mg, peak: ");
+        Serial.print(result->peak);
+        Serial.println(" mg");
+    }
+
+    delayMicroseconds(1000);
+}
@@ -22,9 +22,13 @@
 
 #include <Wire.h>
 #include <limits.h>
+#include <math.h>
 
 #include "MSA300.h"
 
+/* Status registers are read straight into interrupt_t */
+static_assert(sizeof(interrupt_t) == 4, "interrupt_t must mirror the four status registers");
+
 /**************************************************************************/
 /*!
     @brief  Abstract away platform differences in Arduino wire library
@@ -96,7 +100,9 @@ static uint8_t spixfer(uint8_t clock, uint8_t miso, uint8_t mosi, uint8_t data)
 /**************************************************************************/
 void MSA300::writeRegister(uint8_t reg, uint8_t value) 
 {
-  if (_i2c) {
+  if (_bus) {
+    _bus->write(reg, &value, 1);
+  } else if (_i2c) {
     Wire.beginTransmission(MSA300_I2C_ADDRESS_WRITE);
     i2cwrite((uint8_t)reg);
     i2cwrite((uint8_t)(value));
@@ -109,6 +115,39 @@ void MSA300::writeRegister(uint8_t reg, uint8_t value)
   }
 }
 
+/**************************************************************************/
+/*!
+    @brief  Writes consecutive registers in one auto-increment burst
+    @param  reg
+            Address of the first register
+    @param  buffer
+            Register values
+    @param  len
+            Number of registers to write
+*/
+/**************************************************************************/
+void MSA300::writeRegisters(uint8_t reg, const uint8_t *buffer, uint8_t len)
+{
+  if (_bus) {
+    _bus->write(reg, buffer, len);
+  } else if (_i2c) {
+    Wire.beginTransmission(MSA300_I2C_ADDRESS_WRITE);
+    i2cwrite(reg);
+    for (uint8_t i = 0; i < len; i++) {
+      i2cwrite(buffer[i]);
+    }
+    Wire.endTransmission();
+  } else {
+    reg |= 0x40; // multibyte
+    digitalWrite(_cs, LOW);
+    spixfer(_clk, _di, _do, reg);
+    for (uint8_t i = 0; i < len; i++) {
+      spixfer(_clk, _di, _do, buffer[i]);
+    }
+    digitalWrite(_cs, HIGH);
+  }
+}
+
 /**************************************************************************/
 /*!
     @brief  Reads 8-bits from the specified register
@@ -119,11 +158,15 @@ void MSA300::writeRegister(uint8_t reg, uint8_t value)
 /**************************************************************************/
 uint8_t MSA300::readRegister(uint8_t reg) 
 {
-  if (_i2c) {
+  if (_bus) {
+    uint8_t value;
+    _bus->read(reg, &value, 1);
+    return value;
+  } else if (_i2c) {
     Wire.beginTransmission(MSA300_I2C_ADDRESS_READ);
     i2cwrite(reg);
     Wire.endTransmission();
-    Wire.requestFrom(MSA300_ADDRESS_I2C_ADDRESS_READ, 1);
+    Wire.requestFrom(MSA300_I2C_ADDRESS_READ, 1);
     return (i2cread());
   } else {
     reg |= 0x80; // read byte
@@ -145,7 +188,11 @@ uint8_t MSA300::readRegister(uint8_t reg)
 /**************************************************************************/
 int16_t MSA300::read16(uint8_t reg) 
 {
-  if (_i2c) {
+  if (_bus) {
+    uint8_t buffer[2];
+    _bus->read(reg, buffer, 2);
+    return (int16_t)(buffer[0] | (buffer[1] << 8));
+  } else if (_i2c) {
     Wire.beginTransmission(MSA300_I2C_ADDRESS_READ);
     i2cwrite(reg);
     Wire.endTransmission();
@@ -161,6 +208,40 @@ int16_t MSA300::read16(uint8_t reg)
   }    
 }
 
+/**************************************************************************/
+/*!
+    @brief  Reads consecutive registers in one auto-increment burst
+    @param  reg
+            Address of the first register
+    @param  buffer
+            Destination for the register values
+    @param  len
+            Number of registers to read
+*/
+/**************************************************************************/
+void MSA300::readRegisters(uint8_t reg, uint8_t *buffer, uint8_t len)
+{
+  if (_bus) {
+    _bus->read(reg, buffer, len);
+  } else if (_i2c) {
+    Wire.beginTransmission(MSA300_I2C_ADDRESS_READ);
+    i2cwrite(reg);
+    Wire.endTransmission();
+    Wire.requestFrom((uint8_t)MSA300_I2C_ADDRESS_READ, len);
+    for (uint8_t i = 0; i < len; i++) {
+      buffer[i] = i2cread();
+    }
+  } else {
+    reg |= 0x80 | 0x40; // read byte | multibyte
+    digitalWrite(_cs, LOW);
+    spixfer(_clk, _di, _do, reg);
+    for (uint8_t i = 0; i < len; i++) {
+      buffer[i] = spixfer(_clk, _di, _do, 0xFF);
+    }
+    digitalWrite(_cs, HIGH);
+  }
+}
+
 /**************************************************************************/
 /*! 
     @brief  Read the part ID (can be used to check connection)
@@ -173,6 +254,17 @@ uint8_t MSA300::getPartID(void)
   return readRegister(MSA300_REG_PARTID);
 }
 
+/**************************************************************************/
+/*! 
+    @brief  Get the ID given to this sensor instance
+    @return Sensor ID
+*/
+/**************************************************************************/
+int32_t MSA300::getSensorID(void) 
+{
+  return _sensorID;
+}
+
 /**************************************************************************/
 /*! 
     @brief  Gets the most recent X axis value
@@ -217,7 +309,18 @@ MSA300::MSA300(int32_t sensorID)
 {
   _sensorID = sensorID;
   _range = MSA300_RANGE_2_G;
+  _res = MSA300_RES_14_BIT;
+  updateMultiplier();
   _i2c = true;
+  _bus = NULL;
+  _latch = MSA300_INT_NON_LATCHED;
+  _mode = MSA300_MODE_NORMAL;
+  _activeMode = MSA300_MODE_NORMAL;
+  _dataRate = MSA300_DATARATE_1000_HZ;
+  _bandwidth = MSA300_BW_500_HZ;
+  _settling = false;
+  _int1Sources = 0;
+  _int2Sources = 0;
 }
 
 /**************************************************************************/
@@ -239,27 +342,65 @@ MSA300::MSA300(uint8_t clock, uint8_t miso, uint8_t mosi, uint8_t cs, int32_t se
 {
   _sensorID = sensorID;
   _range = MSA300_RANGE_2_G;
-  _multiplier = MSA300_MG2G_MULTIPLIER_2_G;
+  _res = MSA300_RES_14_BIT;
+  updateMultiplier();
   _cs = cs;
   _clk = clock;
   _do = mosi;
   _di = miso;
   _i2c = false;
+  _bus = NULL;
+  _latch = MSA300_INT_NON_LATCHED;
+  _mode = MSA300_MODE_NORMAL;
+  _activeMode = MSA300_MODE_NORMAL;
+  _dataRate = MSA300_DATARATE_1000_HZ;
+  _bandwidth = MSA300_BW_500_HZ;
+  _settling = false;
+  _int1Sources = 0;
+  _int2Sources = 0;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Setups the HW (reads coefficients values, etc.)
+    @brief  Instantiates a new MSA300 class on a custom register bus
+    @param  bus
+            Register bus, e.g. a simulated chip
+    @param  sensorID
+            ID for identifying different sensors
+*/
+/**************************************************************************/
+MSA300::MSA300(MSA300Bus &bus, int32_t sensorID) 
+{
+  _sensorID = sensorID;
+  _range = MSA300_RANGE_2_G;
+  _res = MSA300_RES_14_BIT;
+  updateMultiplier();
+  _i2c = false;
+  _bus = &bus;
+  _latch = MSA300_INT_NON_LATCHED;
+  _mode = MSA300_MODE_NORMAL;
+  _activeMode = MSA300_MODE_NORMAL;
+  _dataRate = MSA300_DATARATE_1000_HZ;
+  _bandwidth = MSA300_BW_500_HZ;
+  _settling = false;
+  _int1Sources = 0;
+  _int2Sources = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set up the bus and check that the chip answers
     @retval True 
             Connection was established
     @retval False 
             No MSA300 was detected
 */
 /**************************************************************************/
-bool MSA300::begin() 
+bool MSA300::connect(void)
 {
-  
-  if (_i2c)
+  if (_bus) {
+    /* Custom bus is set up by its owner */
+  } else if (_i2c)
     Wire.begin();
   else {
     pinMode(_cs, OUTPUT);
@@ -270,21 +411,215 @@ bool MSA300::begin()
   }
 
   /* Check connection */
-  uint8_t partid = getPartID();
-  if (partid != 0x00)
+  if (getPartID() != 0x00)
   {
     /* No MSA300 detected ... return false */
-    Serial.println(partid, HEX);
+    return false;
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Setups the HW (reads coefficients values, etc.)
+    @retval True 
+            Connection was established
+    @retval False 
+            No MSA300 was detected
+*/
+/**************************************************************************/
+bool MSA300::begin() 
+{
+  if (!connect()) {
     return false;
   }
   
-  // Enable measurements
-  writeRegister(MSA300_REG_PWR_MODE_BW, 0x14);  // Normal mode & 500 Hz Bandwidth
-  writeRegister(MSA300_REG_ODR, MSA300_DATARATE_1000_HZ) // Set Output Data Rate to 1000 Hz
+  /* One burst RES_RANGE .. FREEFALL_HY holds the rate and mode and
+     everything the driver caches. After a warm MCU reset the chip keeps
+     its configuration, the caches must follow it. */
+  uint8_t regs[MSA300_REG_FREEFALL_HY - MSA300_REG_RES_RANGE + 1];
+  uint8_t image[MSA300_IMAGE_SIZE];
+  readRegisters(MSA300_REG_RES_RANGE, regs, sizeof(regs));
+  packImage(regs, image, 4);  // RES_RANGE .. FREEFALL_HY
+
+  // Enable measurements: 1000 Hz output data rate, normal mode & 500 Hz bandwidth.
+  // After a warm MCU reset the chip often holds them already.
+  const uint8_t defaults[2] = {MSA300_DATARATE_1000_HZ, 0x14};
+  bool rate = memcmp(&image[1], defaults, sizeof(defaults)) != 0;
+  if (rate) {
+    writeRegisters(MSA300_REG_ODR, defaults, sizeof(defaults));
+    memcpy(&image[1], defaults, sizeof(defaults));
+  }
+  loadImage(image);
+  if (rate) {
+    startSettling(true);
+  }
     
   return true;
 }
 
+/**************************************************************************/
+/*!
+    @brief  Setups the HW with a stored configuration instead of the
+            defaults. The current configuration is read first and only
+            the register runs that differ are written, so a chip that
+            kept its state over an MCU reset costs no writes.
+    @param  image
+            MSA300_IMAGE_SIZE bytes from readImage()
+    @retval True 
+            Connection was established
+    @retval False 
+            No MSA300 was detected
+*/
+/**************************************************************************/
+bool MSA300::begin(const uint8_t *image) 
+{
+  if (!connect()) {
+    return false;
+  }
+
+  uint8_t current[MSA300_IMAGE_SIZE];
+  readImage(current);
+  writeImage(image, current);
+
+  return true;
+}
+
+/* Contiguous runs of writable configuration registers, in image order */
+static const uint8_t imageRuns[][2] = {
+  {MSA300_REG_RES_RANGE, 4},        // RES_RANGE .. SWAP_POLARITY
+  {MSA300_REG_INT_SET_0, 2},        // INT_SET_0 .. INT_SET_1
+  {MSA300_REG_INT_MAP_0, 3},        // INT_MAP_0 .. INT_MAP_2_1
+  {MSA300_REG_INT_MAP_2_2, 5},      // INT_MAP_2_2 .. FREEFALL_HY
+  {MSA300_REG_ACTIVE_DUR, 7},       // ACTIVE_DUR .. Z_BLOCK
+  {MSA300_REG_OFFSET_COMP_X, 3}     // OFFSET_COMP_X .. OFFSET_COMP_Z
+};
+
+/**************************************************************************/
+/*!
+    @brief  Read the complete configuration. Two burst reads, 0x0F-0x2D
+            and 0x38-0x3A, each within the 32 byte Wire buffer.
+    @param  image
+            MSA300_IMAGE_SIZE bytes to fill
+*/
+/**************************************************************************/
+void MSA300::readImage(uint8_t *image)
+{
+  uint8_t regs[MSA300_REG_Z_BLOCK - MSA300_REG_RES_RANGE + 1];
+
+  readRegisters(MSA300_REG_RES_RANGE, regs, sizeof(regs));
+
+  image += packImage(regs, image, sizeof(imageRuns) / sizeof(imageRuns[0]) - 1);
+  readRegisters(MSA300_REG_OFFSET_COMP_X, image, 3);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copy the first runs of the image out of a burst read
+    @param  regs
+            Registers from MSA300_REG_RES_RANGE on
+    @param  image
+            Image to fill
+    @param  runs
+            Number of runs to copy
+    @return Number of image bytes filled
+*/
+/**************************************************************************/
+uint8_t MSA300::packImage(const uint8_t *regs, uint8_t *image, uint8_t runs)
+{
+  uint8_t offset = 0;
+
+  for (uint8_t run = 0; run < runs; run++) {
+    memcpy(&image[offset], &regs[imageRuns[run][0] - MSA300_REG_RES_RANGE], imageRuns[run][1]);
+    offset += imageRuns[run][1];
+  }
+
+  return offset;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write a complete configuration, one burst per contiguous run
+            of registers so that reserved addresses are never written.
+            Cached range, resolution, mode, latch and routing follow the
+            image.
+    @param  image
+            MSA300_IMAGE_SIZE bytes from readImage()
+    @param  current
+            Image the chip holds now, from readImage(). Runs that match
+            it are skipped. NULL writes every run.
+    @return Number of register runs written
+*/
+/**************************************************************************/
+uint8_t MSA300::writeImage(const uint8_t *image, const uint8_t *current)
+{
+  uint8_t offset = 0;
+  uint8_t written = 0;
+  bool rate = false;
+
+  for (uint8_t run = 0; run < sizeof(imageRuns) / sizeof(imageRuns[0]); run++) {
+    uint8_t len = imageRuns[run][1];
+    if (!current || memcmp(&image[offset], &current[offset], len) != 0) {
+      writeRegisters(imageRuns[run][0], &image[offset], len);
+      written++;
+      rate |= (run == 0);
+    }
+    offset += len;
+  }
+
+  loadImage(image);
+
+  /* Data rate, mode or bandwidth changed, the filters start over */
+  if (rate) {
+    startSettling(true);
+  }
+
+  return written;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set cached range, resolution, mode, latch and routing from an
+            image
+    @param  image
+            Image, only the runs up to INT_LATCH are used
+*/
+/**************************************************************************/
+void MSA300::loadImage(const uint8_t *image)
+{
+  /* Image offsets: RES_RANGE 0, ODR 1, PWR_MODE_BW 2, INT_SET_0 4, INT_MAP_0 6,
+     INT_MAP_1 7, INT_MAP_2_1 8, INT_LATCH 10 */
+  _range = (range_t)(image[0] & 0x3);
+  _res = (res_t)((image[0] >> 2) & 0x3);
+  _dataRate = (dataRate_t)(image[1] & 0x0F);
+  _mode = (pwrMode_t)((image[2] >> 6) & 0x3);
+  _bandwidth = (bandwidth_t)((image[2] >> 1) & 0x0F);
+  _latch = (intMode_t)(image[10] & 0x0F);
+  updateMultiplier();
+  if (_mode != MSA300_MODE_SUSPEND) {
+    _activeMode = _mode;
+  }
+
+  /* Invert the routing plan of routeInterrupts() */
+  uint16_t enabled = image[4] | (image[5] << 8);
+  uint16_t *sources[2] = {&_int1Sources, &_int2Sources};
+  uint8_t motion[2] = {image[6], image[8]};
+  for (uint8_t pin = 0; pin < 2; pin++) {
+    uint16_t routed = motion[pin] & (MSA300_INT_SRC_DOUBLE_TAP | MSA300_INT_SRC_SINGLE_TAP | MSA300_INT_SRC_ORIENT);
+    if (motion[pin] & (1 << 2)) {
+      routed |= MSA300_INT_SRC_ACTIVE;
+    }
+    if (motion[pin] & (1 << 0)) {
+      routed |= MSA300_INT_SRC_FREEFALL;
+    }
+    if (image[7] & (pin == 0 ? (1 << 0) : (1 << 7))) {
+      routed |= MSA300_INT_SRC_NEW_DATA;
+    }
+    *sources[pin] = routed & enabled;
+  }
+}
+
 /**************************************************************************/
 /*!
     @brief  Sets the g range for the accelerometer
@@ -307,21 +642,19 @@ void MSA300::setRange(range_t range)
   
   /* Keep track of the current range (to avoid readbacks) */
   _range = range;
+  updateMultiplier();
+}
 
-  /* Map correct conversion multiplier */
-  switch(range) {
-    case MSA300_RANGE_16_G:
-      _multiplier = MSA300_MG2G_MULTIPLIER_16_G;
-      break;
-    case MSA300_RANGE_8_G:
-      _multiplier = MSA300_MG2G_MULTIPLIER_8_G;
-      break;
-    case MSA300_RANGE_4_G:
-      _multiplier = MSA300_MG2G_MULTIPLIER_4_G;
-      break;
-    case MSA300_RANGE_2_G:
-      _multiplier = MSA300_MG2G_MULTIPLIER_2_G;
-  }
+/**************************************************************************/
+/*!
+    @brief  Map the conversion multiplier of the cached range. Samples
+            are left aligned 16 bit words, the multiplier is in g per
+            word, the same at every resolution.
+*/
+/**************************************************************************/
+void MSA300::updateMultiplier(void)
+{
+  _multiplier = (float)(2 << _range) / 32768.0f;
 }
 
 /**************************************************************************/
@@ -349,7 +682,7 @@ void MSA300::setResolution(res_t resolution)
 
   /* Update the resolution */
   format &= ~0xC; // clear resolution bits
-  format |= resolution;
+  format |= (resolution << 2);
 
   
   /* Write the register back to the IC */
@@ -367,22 +700,59 @@ void MSA300::setResolution(res_t resolution)
 /**************************************************************************/
 res_t MSA300::getResolution(void)
 {
-  return (res_t)(readRegister(MSA300_REG_RES_RANGE) & 0xC);
+  return (res_t)((readRegister(MSA300_REG_RES_RANGE) >> 2) & 0x3);
 }
 
 
 /**************************************************************************/
 /*!
-    @brief  Sets the data rate for the MSA300 (controls power consumption)
+    @brief  Sets the data rate for the MSA300 (controls power consumption).
+            The low power bandwidth is kept, see setBandwidth(). 500 Hz and
+            1000 Hz are not available in low power mode and are clamped to
+            250 Hz there.
     @param  dataRate
             Output data rate
 */
 /**************************************************************************/
 void MSA300::setDataRate(dataRate_t dataRate)
 {
-  /* Note: The LOW_POWER bits are currently ignored and we always keep
-     the device in 'normal' mode */
-  writeRegister(MSA300_REG_BW_RATE, dataRate);
+  if (_activeMode == MSA300_MODE_LOW &&
+      (dataRate == MSA300_DATARATE_500_HZ || dataRate == MSA300_DATARATE_1000_HZ)) {
+    dataRate = MSA300_DATARATE_250_HZ;
+  }
+
+  writeRegister(MSA300_REG_ODR, dataRate);
+  _dataRate = dataRate;
+  startSettling(false);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the bandwidth used in low power mode. Normal mode always
+            filters at half the data rate.
+    @param  bandwidth
+            Low power bandwidth
+*/
+/**************************************************************************/
+void MSA300::setBandwidth(bandwidth_t bandwidth)
+{
+  /* Mode and bandwidth are the only contents of the register */
+  writeRegister(MSA300_REG_PWR_MODE_BW, (_mode << 6) | (bandwidth << 1));
+  _bandwidth = bandwidth;
+  if (_mode == MSA300_MODE_LOW) {
+    startSettling(false);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the bandwidth used in low power mode
+    @return Low power bandwidth
+*/
+/**************************************************************************/
+bandwidth_t MSA300::getBandwidth(void)
+{
+  return _bandwidth;
 }
 
 /**************************************************************************/
@@ -393,7 +763,7 @@ void MSA300::setDataRate(dataRate_t dataRate)
 /**************************************************************************/
 dataRate_t MSA300::getDataRate(void)
 {
-  return (dataRate_t)(readRegister(MSA300_REG_BW_RATE) & 0x0F);
+  return (dataRate_t)(readRegister(MSA300_REG_ODR) & 0x0F);
 }
 
 /**************************************************************************/
@@ -410,14 +780,22 @@ void MSA300::setMode(pwrMode_t mode)
 
   /* Update the mode */
   format &= ~0xC0; // clear the mode bits
-  format |= mode;
+  format |= (mode << 6);
+  _bandwidth = (bandwidth_t)((format >> 1) & 0x0F);
 
   
   /* Write the register back to the IC */
   writeRegister(MSA300_REG_PWR_MODE_BW, format);
   
   /* Keep track of the current mode (to avoid readbacks) */
+  bool wake = (mode != _mode && mode != MSA300_MODE_SUSPEND);
   _mode = mode;
+  if (mode != MSA300_MODE_SUSPEND) {
+    _activeMode = mode;
+  }
+  if (wake) {
+    startSettling(true);
+  }
 }
 
 /**************************************************************************/
@@ -428,24 +806,264 @@ void MSA300::setMode(pwrMode_t mode)
 /**************************************************************************/
 pwrMode_t MSA300::getMode(void)
 {
-  return (pwrMode_t)(readRegister(MSA300_REG_PWR_MODE_BW) & 0xC0);
+  return (pwrMode_t)((readRegister(MSA300_REG_PWR_MODE_BW) >> 6) & 0x3);
 }
 
+/* Data rates the optimizer tries, slowest first */
+static const dataRate_t powerRates[] = {
+  MSA300_DATARATE_1_HZ, MSA300_DATARATE_1_95_HZ, MSA300_DATARATE_3_9_HZ,
+  MSA300_DATARATE_7_81_HZ, MSA300_DATARATE_15_63_HZ, MSA300_DATARATE_31_25_HZ,
+  MSA300_DATARATE_62_5_HZ, MSA300_DATARATE_125_HZ, MSA300_DATARATE_250_HZ,
+  MSA300_DATARATE_500_HZ, MSA300_DATARATE_1000_HZ
+};
+
 /**************************************************************************/
 /*!
-    @brief  Reset all latched interrupts
+    @brief  Estimate signal bandwidth, noise and supply current of a power
+            configuration at the current range and resolution. Uses the
+            POWER MODEL defines. In low power mode the front end is on for
+            MSA300_LOW_POWER_WAKE_US plus half a bandwidth period per
+            sample, a wider bandwidth is noisier but sleeps longer.
+    @param  mode
+            Power mode, normal or low power
+    @param  dataRate
+            Output data rate
+    @param  bandwidth
+            Low power bandwidth, ignored in normal mode
+    @param  config
+            Estimate
+    @return False if the chip does not support the combination
 */
 /**************************************************************************/
-void MSA300::resetInterrupt(void)
+bool MSA300::estimatePower(pwrMode_t mode, dataRate_t dataRate, bandwidth_t bandwidth, powerConfig_t *config)
 {
-  /* Read register to preserve bits */
-  uint8_t reg = readRegister(MSA300_REG_INT_LATCH);
+  float rate = dataRateToHz(dataRate);
+  float filter;
+  float density;
+
+  if (mode == MSA300_MODE_NORMAL) {
+    if (dataRate == MSA300_DATARATE_1_HZ || dataRate == MSA300_DATARATE_1_95_HZ) {
+      return false;
+    }
+    filter = rate / 2;
+    density = MSA300_NOISE_NORMAL_UG;
+    config->currentUa = MSA300_CURRENT_NORMAL_UA;
+  } else if (mode == MSA300_MODE_LOW) {
+    if (dataRate == MSA300_DATARATE_500_HZ || dataRate == MSA300_DATARATE_1000_HZ) {
+      return false;
+    }
+    filter = bandwidthToHz(bandwidth);
+    density = MSA300_NOISE_LOW_POWER_UG;
+    float duty = rate * (MSA300_LOW_POWER_WAKE_US / 1000000.0f + 0.5f / filter);
+    if (duty > 1) {
+      duty = 1;
+    }
+    config->currentUa = MSA300_CURRENT_SUSPEND_UA +
+                        (MSA300_CURRENT_NORMAL_UA - MSA300_CURRENT_SUSPEND_UA) * duty;
+  } else {
+    return false;
+  }
 
-  /* Turn RESET_INT bit on */
-  reg |= (1 << 7);
+  /* Noise above the Nyquist frequency folds back, it is not filtered */
+  float analog = density / 1000.0f * sqrtf(filter);
+  float step = (2000.0f * (1 << _range) / 32768) * (1 << (16 - resolutionBits(_res)));
+  float quantization = step * step / 12;
 
-  /* Write the register back to the IC */
-  writeRegister(MSA300_REG_INT_LATCH, reg);
+  config->mode = mode;
+  config->dataRate = dataRate;
+  config->bandwidth = (mode == MSA300_MODE_LOW) ? bandwidth : MSA300_BW_500_HZ;
+  config->bandwidthHz = (filter < rate / 2) ? filter : rate / 2;
+  config->noiseMg = sqrtf(analog * analog + quantization);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pick power mode, data rate and bandwidth with the lowest
+            estimated current that still passes the signal bandwidth and
+            stays under the noise floor, then write ODR and PWR_MODE_BW in
+            one burst. Ties go to the lower noise, then to the lower data
+            rate. Nothing is written if no configuration fits.
+    @param  bandwidthHz
+            Required signal bandwidth
+    @param  noiseMg
+            Highest acceptable rms noise
+    @param  config
+            Chosen configuration, can be NULL
+    @return False if no configuration fits
+*/
+/**************************************************************************/
+bool MSA300::optimizePower(float bandwidthHz, float noiseMg, powerConfig_t *config)
+{
+  powerConfig_t best;
+  powerConfig_t candidate;
+  bool found = false;
+
+  for (uint8_t i = 0; i < sizeof(powerRates) / sizeof(powerRates[0]); i++) {
+    for (uint8_t bw = MSA300_BW_1_95_HZ; bw <= MSA300_BW_500_HZ + 1; bw++) {
+      /* The last pass is normal mode, bandwidth bits unused */
+      pwrMode_t mode = (bw > MSA300_BW_500_HZ) ? MSA300_MODE_NORMAL : MSA300_MODE_LOW;
+      if (!estimatePower(mode, powerRates[i], (bandwidth_t)bw, &candidate)) {
+        continue;
+      }
+      if (candidate.bandwidthHz < bandwidthHz || candidate.noiseMg > noiseMg) {
+        continue;
+      }
+      if (!found || candidate.currentUa < best.currentUa ||
+          (candidate.currentUa == best.currentUa && candidate.noiseMg < best.noiseMg)) {
+        best = candidate;
+        found = true;
+      }
+    }
+  }
+
+  if (!found) {
+    return false;
+  }
+
+  uint8_t regs[2] = {(uint8_t)best.dataRate, (uint8_t)((best.mode << 6) | (best.bandwidth << 1))};
+  writeRegisters(MSA300_REG_ODR, regs, sizeof(regs));
+  _dataRate = best.dataRate;
+  _bandwidth = best.bandwidth;
+  _mode = best.mode;
+  _activeMode = best.mode;
+  startSettling(true);
+
+  if (config) {
+    *config = best;
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reset every register to its power-on value. Blocks for
+            MSA300_RESET_TIME_US, the chip does not answer before that.
+            Cached range, resolution, mode, latch and routing return to
+            their defaults.
+*/
+/**************************************************************************/
+void MSA300::softReset(void)
+{
+  writeRegister(MSA_300_REG_SOFT_RESET, MSA300_SOFT_RESET);
+  delayMicroseconds(MSA300_RESET_TIME_US);
+
+  _range = MSA300_RANGE_2_G;
+  _res = MSA300_RES_14_BIT;
+  _latch = MSA300_INT_NON_LATCHED;
+  _int1Sources = 0;
+  _int2Sources = 0;
+
+  /* Rate, mode and bandwidth come back from the chip in one burst */
+  uint8_t regs[2];
+  readRegisters(MSA300_REG_ODR, regs, sizeof(regs));
+  _dataRate = (dataRate_t)(regs[0] & 0x0F);
+  _mode = (pwrMode_t)((regs[1] >> 6) & 0x3);
+  _bandwidth = (bandwidth_t)((regs[1] >> 1) & 0x0F);
+  _activeMode = (_mode == MSA300_MODE_SUSPEND) ? MSA300_MODE_NORMAL : _mode;
+  updateMultiplier();
+  startSettling(true);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Put the chip into suspend mode. Configuration is kept and
+            resume() returns to the mode it was in.
+*/
+/**************************************************************************/
+void MSA300::suspend(void)
+{
+  setMode(MSA300_MODE_SUSPEND);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Return from suspend to the last active mode. Does not wait,
+            samples read before the returned latency has passed are not
+            settled, see settled().
+    @return Wake to first valid sample latency in microseconds
+*/
+/**************************************************************************/
+uint32_t MSA300::resume(void)
+{
+  setMode(_activeMode);
+
+  return _settling ? _settleTime : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the time from a wake up to the first valid sample in the
+            mode the chip runs or resumes to, from cached settings without
+            a bus access. Normal mode: MSA300_WAKE_TIME_US plus
+            MSA300_SETTLING_SAMPLES output periods. Low power mode adds
+            the per-sample start up MSA300_LOW_POWER_WAKE_US, and the
+            filters settle in periods of the data rate or of the
+            bandwidth, whichever is longer. A scheduler can use it to
+            wake the chip ahead of time instead of waiting.
+    @return Latency in microseconds
+*/
+/**************************************************************************/
+uint32_t MSA300::getWakeLatency(void)
+{
+  float period = 1000000.0f / dataRateToHz(_dataRate);
+  uint32_t latency = MSA300_WAKE_TIME_US;
+
+  if (_activeMode == MSA300_MODE_LOW) {
+    float filter = 500000.0f / bandwidthToHz(_bandwidth);
+    if (filter > period) {
+      period = filter;
+    }
+    latency += MSA300_LOW_POWER_WAKE_US;
+  }
+
+  return latency + (uint32_t)(MSA300_SETTLING_SAMPLES * period);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start the settling window after a transition
+    @param  wake
+            True if the transition restarts conversions (mode change),
+            false if only the filters restart (data rate change)
+*/
+/**************************************************************************/
+void MSA300::startSettling(bool wake)
+{
+  _settleTime = getWakeLatency() - (wake ? 0 : MSA300_WAKE_TIME_US);
+  _settleStart = micros();
+  _settling = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if the output has settled after the last mode or data
+            rate change. Samples read while this is false are garbage.
+    @return True if samples are valid
+*/
+/**************************************************************************/
+bool MSA300::settled(void)
+{
+  if (_settling && (uint32_t)(micros() - _settleStart) >= _settleTime) {
+    _settling = false;
+  }
+
+  return !_settling;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reset all latched interrupts. Writes the cached latch mode
+            back, which begin() and setInterruptLatch() keep in step with
+            the chip. A latch mode written with writeRegister() is not seen.
+*/
+/**************************************************************************/
+void MSA300::resetInterrupt(void)
+{
+  /* Latch mode is the only other content of the register, write it back with RESET_INT on */
+  writeRegister(MSA300_REG_INT_LATCH, _latch | (1 << 7));
 }
 
 /**************************************************************************/
@@ -455,48 +1073,26 @@ void MSA300::resetInterrupt(void)
 /**************************************************************************/
 void MSA300::clearInterrupts(void)
 {
-  writeRegister(MSA300_REG_INT_SET_0, 0x00);
-  writeRegister(MSA300_REG_INT_SET_1, 0x00);
-  writeRegister(MSA300_REG_INT_MAP_0, 0x00);
-  writeRegister(MSA300_REG_INT_MAP_2_1, 0x00);
+  routeInterrupts(0, 0);
   writeRegister(MSA300_REG_INT_MAP_2_2, 0x00);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Check interrupt registers for all occured interrupts. Return
-            struct with booleans of all triggered interrupts.
-    @return Struct containing boolean status of interrupts.
+    @brief  Check interrupt registers for all occured interrupts. Interrupt,
+            tap/active and orientation status are read in one burst.
+    @return Struct containing the status of interrupts.
 */
 /**************************************************************************/
 interrupt_t MSA300::checkInterrupts(void)
 {
   interrupt_t interrupts;
-  uint8_t motionReg = readRegister(MSA300_REG_MOTION_INT);
-  uint8_t dataReg = readRegister(MSA300_REG_DATA_INT);
-  uint8_t tapReg = readRegister(MSA300_REG_TAP_ACTIVE_STATUS);
-
-  interrupts.orientInt = (motionReg >> 6) & 1;
-  interrups.sTapInt = (motionReg >> 5) & 1;
-  interrups.dTapInt = (motionReg >> 4) & 1;
-  interrups.activeInt = (motionReg >> 2) & 1;
-  interrups.freefallInt = (motionReg >> 0) & 1;
-  interrups.newdataInt = (dataReg >> 0) & 1;
-
-  /* If there was active or tap interrupts, populate intStatus struct */
-  if(interrups.activeInt || interrupts.sTapInt || interrupts.dTapInt) {
-    interrupts.intStatus.tapSign = (tapReg >> 7) & 1;
-    interrupts.intStatus.tapFirstX = (tapReg >> 6) & 1;
-    interrupts.intStatus.tapFirstY = (tapReg >> 5) & 1;
-    interrupts.intStatus.tapFirstZ = (tapReg >> 4) & 1;
-    interrupts.intStatus.activeSign = (tapReg >> 3) & 1;
-    interrupts.intStatus.activeFirstX = (tapReg >> 2) & 1;
-    interrupts.intStatus.activeFirstY = (tapReg >> 1) & 1;
-    interrupts.intStatus.activeFirstZ = (tapReg >> 0) & 1;
-  }
+
+  readRegisters(MSA300_REG_MOTION_INT, &interrupts.motion, sizeof(interrupts));
 
   return interrupts;
 }
+
 /**************************************************************************/
 /*!
     @brief  Set interrupt latching mode
@@ -510,113 +1106,184 @@ void MSA300::setInterruptLatch(intMode_t mode)
   uint8_t reg = readRegister(MSA300_REG_INT_LATCH);
 
   /* Update latching mode */
-  reg &= ~0xF0;
+  reg &= ~0x0F;
   reg |= mode;
 
   /* Write the register back to the IC */
   writeRegister(MSA300_REG_INT_LATCH, reg);
+
+  /* Keep track of the latch mode (lets resetInterrupt() skip the readback) */
+  _latch = mode;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Turn on active interrupt. Interrupt parameter corresponds to
-            interrupt pins.
-    @param  axis
-            Axis to set active interrupt on
-    @param  interrupt
-            Index of interrupt (1 or 2)
+    @brief  Get the interrupt latching mode last set with setInterruptLatch()
+    @return Interrupt mode
 */
 /**************************************************************************/
-void MSA300::enableActiveInterrupt(axis_t axis, uint8_t interrupt) 
+intMode_t MSA300::getInterruptLatch(void)
 {
-  switch(interrupt) {
-    case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_0);
-      reg |= (1 << 2);
-      writeRegister(MSA300_REG_INT_MAP_0, reg);
-      break;
-    case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_2_1);
-      reg |= (1 << 2);
-      writeRegister(MSA300_REG_INT_MAP_2_1, reg);
-      break;
+  return _latch;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Plan and write the complete interrupt routing. Enable and map
+            registers are computed from the source sets and written in two
+            bursts (INT_SET_0-1 and INT_MAP_0-2_1), replacing any previous
+            routing. A source can be routed to both pins.
+    @param  int1
+            Sources routed to INT1, intSource_t values combined with |
+    @param  int2
+            Sources routed to INT2, intSource_t values combined with |
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts and nothing was written. Active axes share one
+            map bit per pin, so both pins must carry the same active axes.
+*/
+/**************************************************************************/
+bool MSA300::routeInterrupts(uint16_t int1, uint16_t int2)
+{
+  uint16_t all = int1 | int2;
+  uint16_t active1 = int1 & MSA300_INT_SRC_ACTIVE;
+  uint16_t active2 = int2 & MSA300_INT_SRC_ACTIVE;
+
+  if ((all & ~MSA300_INT_SRC_ALL) || (active1 && active2 && active1 != active2)) {
+    return false;
   }
 
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_0);
-
-  switch(axis) {
-    case MSA300_AXIS_X:
-      reg |= (1 << 0);
-      break;
-    case MSA300_AXIS_Y:
-      reg |= (1 << 1);
-      break;
-    case MSA300_AXIS_Z:
-      reg |= (1 << 2);
-      break;
+  /* Source bits are the INT_SET_0 (low byte) and INT_SET_1 (high byte) enable bits */
+  uint8_t set[2] = {
+    (uint8_t)(all & 0xFF),
+    (uint8_t)(all >> 8)
+  };
+
+  /* INT_MAP_0 and INT_MAP_2_1 share a layout: freefall 0, active 2, double tap 4, single tap 5, orientation 6 */
+  uint8_t map[3] = {0, 0, 0};
+  uint16_t pins[2] = {int1, int2};
+  for (uint8_t pin = 0; pin < 2; pin++) {
+    uint8_t motion = pins[pin] & (MSA300_INT_SRC_DOUBLE_TAP | MSA300_INT_SRC_SINGLE_TAP | MSA300_INT_SRC_ORIENT);
+    if (pins[pin] & MSA300_INT_SRC_ACTIVE) {
+      motion |= (1 << 2);
+    }
+    if (pins[pin] & MSA300_INT_SRC_FREEFALL) {
+      motion |= (1 << 0);
+    }
+    map[pin == 0 ? 0 : 2] = motion;
   }
+  map[1] = ((int1 & MSA300_INT_SRC_NEW_DATA) ? (1 << 0) : 0) |
+           ((int2 & MSA300_INT_SRC_NEW_DATA) ? (1 << 7) : 0);
+
+  writeRegisters(MSA300_REG_INT_SET_0, set, sizeof(set));
+  writeRegisters(MSA300_REG_INT_MAP_0, map, sizeof(map));
 
-  writeRegister(MSA300_REG_INT_SET_0, reg);
+  _int1Sources = int1;
+  _int2Sources = int2;
+
+  return true;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Toggle freefall interrupt. Interrupt parameter corresponds to
-            interrupt pins.
+    @brief  Add sources to the current routing.
+    @param  sources
+            Sources to enable, intSource_t values combined with |
     @param  interrupt
             Index of interrupt (1 or 2)
+    @return True if the routing was written, see routeInterrupts()
 */
 /**************************************************************************/
-void MSA300::enableFreefallInterrupt(uint8_t interrupt)
+bool MSA300::enableInterrupt(uint16_t sources, uint8_t interrupt)
 {
   switch(interrupt) {
     case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_0);
-      reg |= (1 << 0);
-      writeRegister(MSA300_REG_INT_MAP_0, reg);
-      break;
+      return routeInterrupts(_int1Sources | sources, _int2Sources);
     case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_2_1);
-      reg |= (1 << 0);
-      writeRegister(MSA300_REG_INT_MAP_2_1, reg);
-      break;
+      return routeInterrupts(_int1Sources, _int2Sources | sources);
   }
 
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_1);
-  
-  reg |= (1 << 3);
+  return false;
+}
 
-  writeRegister(MSA300_REG_INT_SET_1, reg);
+/**************************************************************************/
+/*!
+    @brief  Remove sources from the current routing on both pins, leaving
+            all other sources as they are.
+    @param  sources
+            Sources to disable, intSource_t values combined with |
+*/
+/**************************************************************************/
+void MSA300::disableInterrupt(uint16_t sources)
+{
+  routeInterrupts(_int1Sources & ~sources, _int2Sources & ~sources);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Enable freefall interrupt. Interrupt parameter corresponds to
+    @brief  Get the sources currently routed to a pin.
+    @param  interrupt
+            Index of interrupt (1 or 2)
+    @return Sources, intSource_t values combined with |
+*/
+/**************************************************************************/
+uint16_t MSA300::getRoutedInterrupts(uint8_t interrupt)
+{
+  return (interrupt == 1) ? _int1Sources : (interrupt == 2) ? _int2Sources : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Turn on active interrupt. Interrupt parameter corresponds to
             interrupt pins.
+    @param  axis
+            Axis to set active interrupt on
     @param  interrupt
             Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
 */
 /**************************************************************************/
-void MSA300::enableOrientationInterrupt(uint8_t interrupt)
+bool MSA300::enableActiveInterrupt(axis_t axis, uint8_t interrupt) 
 {
-  switch(interrupt) {
-    case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_0);
-      reg |= (1 << 6);
-      writeRegister(MSA300_REG_INT_MAP_0, reg);
-      break;
-    case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_2_1);
-      reg |= (1 << 6);
-      writeRegister(MSA300_REG_INT_MAP_2_1, reg);
-      break;
-  }
+  return enableInterrupt(MSA300_INT_SRC_ACTIVE_X << axis, interrupt);
+}
 
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_0);
-  
-  reg |= (1 << 6);
+/**************************************************************************/
+/*!
+    @brief  Toggle freefall interrupt. Interrupt parameter corresponds to
+            interrupt pins.
+    @param  interrupt
+            Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
+*/
+/**************************************************************************/
+bool MSA300::enableFreefallInterrupt(uint8_t interrupt)
+{
+  return enableInterrupt(MSA300_INT_SRC_FREEFALL, interrupt);
+}
 
-  writeRegister(MSA300_REG_INT_SET_0, reg);
+/**************************************************************************/
+/*!
+    @brief  Enable orientation interrupt. Interrupt parameter corresponds to
+            interrupt pins.
+    @param  interrupt
+            Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
+*/
+/**************************************************************************/
+bool MSA300::enableOrientationInterrupt(uint8_t interrupt)
+{
+  return enableInterrupt(MSA300_INT_SRC_ORIENT, interrupt);
 }
 
 /**************************************************************************/
@@ -625,28 +1292,15 @@ void MSA300::enableOrientationInterrupt(uint8_t interrupt)
             interrupt pins.
     @param  interrupt
             Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
 */
 /**************************************************************************/
-void MSA300::enableSingleTapInterrupt(uint8_t interrupt)
+bool MSA300::enableSingleTapInterrupt(uint8_t interrupt)
 {
-  switch(interrupt) {
-    case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_0);
-      reg |= (1 << 5);
-      writeRegister(MSA300_REG_INT_MAP_0, reg);
-      break;
-    case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_2_1);
-      reg |= (1 << 5);
-      writeRegister(MSA300_REG_INT_MAP_2_1, reg);
-      break;
-  }
-
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_0);
-  
-  reg |= (1 << 5);
-
-  writeRegister(MSA300_REG_INT_SET_0, reg);
+  return enableInterrupt(MSA300_INT_SRC_SINGLE_TAP, interrupt);
 }
 
 /**************************************************************************/
@@ -655,28 +1309,15 @@ void MSA300::enableSingleTapInterrupt(uint8_t interrupt)
             interrupt pins.
     @param  interrupt
             Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
 */
 /**************************************************************************/
-void MSA300::enableDoubleTapInterrupt(uint8_t interrupt)
+bool MSA300::enableDoubleTapInterrupt(uint8_t interrupt)
 {
-  switch(interrupt) {
-    case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_0);
-      reg |= (1 << 4);
-      writeRegister(MSA300_REG_INT_MAP_0, reg);
-      break;
-    case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_2_1);
-      reg |= (1 << 4);
-      writeRegister(MSA300_REG_INT_MAP_2_1, reg);
-      break;
-  }
-
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_0);
-  
-  reg |= (1 << 4);
-
-  writeRegister(MSA300_REG_INT_SET_0, reg);
+  return enableInterrupt(MSA300_INT_SRC_DOUBLE_TAP, interrupt);
 }
 
 /**************************************************************************/
@@ -685,28 +1326,15 @@ void MSA300::enableDoubleTapInterrupt(uint8_t interrupt)
             interrupt pins.
     @param  interrupt
             Index of interrupt (1 or 2)
+    @retval True
+            Routing was written
+    @retval False
+            Routing conflicts, see routeInterrupts(), nothing was written
 */
 /**************************************************************************/
-void MSA300::enableNewDataInterrupt(uint8_t interrupt)
+bool MSA300::enableNewDataInterrupt(uint8_t interrupt)
 {
-  switch(interrupt) {
-    case 1:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_1);
-      reg |= (1 << 0);
-      writeRegister(MSA300_REG_INT_MAP_1, reg);
-      break;
-    case 2:
-      uint8_t reg = readRegister(MSA300_REG_INT_MAP_1);
-      reg |= (1 << 7);
-      writeRegister(MSA300_REG_INT_MAP_1, reg);
-      break;
-  }
-
-  uint8_t reg = readRegister(MSA300_REG_INT_SET_1);
-  
-  reg |= (1 << 4);
-
-  writeRegister(MSA300_REG_INT_SET_1, reg);
+  return enableInterrupt(MSA300_INT_SRC_NEW_DATA, interrupt);
 }
 
 /**************************************************************************/
@@ -717,61 +1345,126 @@ void MSA300::enableNewDataInterrupt(uint8_t interrupt)
 /**************************************************************************/
 orient_t MSA300::checkOrientation(void)
 {
-  orient_t orientation;
-  uint8_t reg = readRegister(MSA300_REG_ORIENT_STATUS);
+  interrupt_t status;
 
-  orientation.z = (reg >> 6) & 1;
-  orientation.xy = (reg >> 4) & 0x3;
+  status.orient = readRegister(MSA300_REG_ORIENT_STATUS);
 
-  return orientation;
+  return status.orientation();
 }
 
 /**************************************************************************/
 /*!
     @brief  Set offset compensation value for specific axis. Value can vary
-            from 0 to 998.4 mg. 
-            Values outside the range will be clamped.
+            from 0 to 994.5 mg in 3.9 mg steps and is subtracted from the
+            output. Values outside the range will be clamped.
     @param  axis
             Axis to set offset on
     @param  value
-            Offset value (0 to 998.4 mg)
+            Offset value (0 to 994.5 mg)
 */
 /**************************************************************************/
 void MSA300::setOffset(axis_t axis, float value)
 {
-  float offset = value / 3.9f;
-
-  offset = clamp<float>(offset, 0, 998.4f);
-
-  switch(axis) {
-    case MSA300_AXIS_X:
-    uint8_t reg = readRegister(MSA300_REG_OFFSET_COMP_X);
-
-    reg &= ~0xFF;
-    reg |= offset;
-
-    writeRegister(MSA300_REG_OFFSET_COMP_X, reg);
-    break;
-
-    case MSA300_AXIS_Y:
-    uint8_t reg = readRegister(MSA300_REG_OFFSET_COMP_Y);
+  float offset = clamp<float>(value / MSA300_OFFSET_MG_PER_LSB + 0.5f, 0, 255);
 
-    reg &= ~0xFF;
-    reg |= offset;
-
-    writeRegister(MSA300_REG_OFFSET_COMP_Y, reg);
-    break;
-
-    case MSA300_AXIS_Z:
-    uint8_t reg = readRegister(MSA300_REG_OFFSET_COMP_Z);
+  writeRegister(MSA300_REG_OFFSET_COMP_X + axis, (uint8_t)offset);
+}
 
-    reg &= ~0xFF;
-    reg |= offset;
+/**************************************************************************/
+/*!
+    @brief  Calibrate the offset compensation with the device at rest. One
+            axis must point straight up (or down if inverted) so that it
+            reads 1 g and the others 0 g. Collects samples at the current
+            data rate, takes the mean of each axis after rejecting samples
+            further than three median absolute deviations from the median,
+            and programs all three offset registers in one write.
+            The registers can only remove a positive bias, 0 to 994.5 mg.
+    @param  axis
+            Axis pointing along gravity
+    @param  inverted
+            True if the axis points down and reads -1 g
+    @param  samples
+            Number of samples, 1 to MSA300_CALIBRATION_SAMPLES
+    @return Largest remaining bias over the axes in mg, after rounding
+            and clamping to the register range
+*/
+/**************************************************************************/
+float MSA300::calibrate(axis_t axis, bool inverted, uint8_t samples)
+{
+  int16_t values[3][MSA300_CALIBRATION_SAMPLES];
+  uint8_t offsets[3] = {0, 0, 0};
+  uint32_t period = (uint32_t)(1000.0f / dataRateToHz(getDataRate())) + 1;
+  float mgPerLsb = (float)(2000 << _range) / 32768.0f;
+  float residual = 0;
+
+  samples = clamp<uint8_t>(samples, 1, MSA300_CALIBRATION_SAMPLES);
+
+  /* Measure without compensation, skip the sample taken with the old one */
+  writeRegisters(MSA300_REG_OFFSET_COMP_X, offsets, sizeof(offsets));
+  delay(period);
+  for (uint8_t i = 0; i < samples; i++) {
+    rawAcc_t sample;
+
+    delay(period);
+    getRawAcceleration(&sample);
+    values[0][i] = sample.x;
+    values[1][i] = sample.y;
+    values[2][i] = sample.z;
+  }
 
-    writeRegister(MSA300_REG_OFFSET_COMP_Z, reg);
-    break;
+  for (uint8_t a = 0; a < 3; a++) {
+    int16_t *v = values[a];
+    int16_t deviations[MSA300_CALIBRATION_SAMPLES];
+
+    /* Insertion sort, samples are few */
+    for (uint8_t i = 1; i < samples; i++) {
+      int16_t value = v[i];
+      uint8_t j = i;
+      for (; j > 0 && v[j - 1] > value; j--) {
+        v[j] = v[j - 1];
+      }
+      v[j] = value;
+    }
+    int16_t median = v[samples / 2];
+
+    for (uint8_t i = 0; i < samples; i++) {
+      int32_t deviation = v[i] - median;
+      deviations[i] = (int16_t)clamp<int32_t>(deviation < 0 ? -deviation : deviation, 0, INT16_MAX);
+    }
+    for (uint8_t i = 1; i < samples; i++) {
+      int16_t value = deviations[i];
+      uint8_t j = i;
+      for (; j > 0 && deviations[j - 1] > value; j--) {
+        deviations[j] = deviations[j - 1];
+      }
+      deviations[j] = value;
+    }
+    /* At least 1 mg, so quantized data with a zero MAD keeps its neighbours */
+    int32_t limit = 3 * (int32_t)deviations[samples / 2];
+    limit = (limit < (int32_t)(1.0f / mgPerLsb) + 1) ? (int32_t)(1.0f / mgPerLsb) + 1 : limit;
+
+    int32_t sum = 0;
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < samples; i++) {
+      int32_t deviation = v[i] - median;
+      if (deviation >= -limit && deviation <= limit) {
+        sum += v[i];
+        count++;
+      }
+    }
+
+    float expected = (a == axis) ? (inverted ? -1000.0f : 1000.0f) : 0.0f;
+    float bias = (float)sum / count * mgPerLsb - expected;
+    float offset = clamp<float>(bias / MSA300_OFFSET_MG_PER_LSB + 0.5f, 0, 255);
+
+    offsets[a] = (uint8_t)offset;
+    float remaining = fabsf(bias - offsets[a] * MSA300_OFFSET_MG_PER_LSB);
+    residual = (remaining > residual) ? remaining : residual;
   }
 
+  writeRegisters(MSA300_REG_OFFSET_COMP_X, offsets, sizeof(offsets));
+
+  return residual;
 }
 
 /**************************************************************************/
@@ -779,32 +1472,34 @@ void MSA300::setOffset(axis_t axis, float value)
     @brief  Set threshold of tap interrupt. Value can vary from 0 to full
             scale of each range. Values outside the range will be clamped.
     @param  value
-            Tap threshold value (0 to full scale)
+            Tap threshold value in mg (0 to full scale)
 */
 /**************************************************************************/
 void MSA300::setTapThreshold(float value)
 { 
-  float offset;
+  float lsb = 0;
   switch(_range) {
     case MSA300_RANGE_16_G:
-    offset = clamp<float>(value / MSA300_MG2G_TAP_TH_16_G, 0, 16000f);
-    
+    lsb = MSA300_MG2G_TAP_TH_16_G;
     break;
-    case MSA300_RANGE_8_G:
-    offset = clamp<float>(value / MSA300_MG2G_TAP_TH_8_G, 0, 8000f);
 
+    case MSA300_RANGE_8_G:
+    lsb = MSA300_MG2G_TAP_TH_8_G;
     break;
-    case MSA300_RANGE_4_G:
-    offset = clamp<float>(value / MSA300_MG2G_TAP_TH_4_G, 0, 4000f);
 
+    case MSA300_RANGE_4_G:
+    lsb = MSA300_MG2G_TAP_TH_4_G;
     break;
-    case MSA300_RANGE_2_G:
-    offset = clamp<float>(value / MSA300_MG2G_TAP_TH_2_G, 0, 2000f);
 
+    case MSA300_RANGE_2_G:
+    lsb = MSA300_MG2G_TAP_TH_2_G;
     break;
   }
 
-  writeRegister(MSA300_REG_TAP_TH, offset);
+  /* Threshold is given in mg, multipliers are in g. Register is 5 bits wide. */
+  float threshold = clamp<float>(value / (lsb * 1000.0f), 0, 31);
+
+  writeRegister(MSA300_REG_TAP_TH, (uint8_t)threshold);
 }
 
 /**************************************************************************/
@@ -822,7 +1517,7 @@ void MSA300::setTapThreshold(float value)
 /**************************************************************************/
 void MSA300::setTapDuration(tapDuration_t duration, uint8_t quiet, uint8_t shock)
 {
-  uint8_t reg;
+  uint8_t reg = 0;
 
   reg |= (quiet << 7);
   reg |= (shock << 6);
@@ -836,31 +1531,34 @@ void MSA300::setTapDuration(tapDuration_t duration, uint8_t quiet, uint8_t shock
     @brief  Set threshold of active interrupt. Value can vary from 0 to full
             scale of each range. Values outside the range will be clamped.
     @param  value
-            Active threshold value (0 to full scale)
+            Active threshold value in mg (0 to 255 steps of the range)
 */
 /**************************************************************************/
 void MSA300::setActiveThreshold(float value)
 { 
-  float offset;
+  float lsb = 0;
   switch(_range) {
     case MSA300_RANGE_16_G:
-    offset = clamp<float>(value / MSA300_MG2G_ACTIVE_TH_16_G, 0, 16000f);
+    lsb = MSA300_MG2G_ACTIVE_TH_16_G;
     break;
 
     case MSA300_RANGE_8_G:
-    offset = clamp<float>(value / MSA300_MG2G_ACTIVE_TH_8_G, 0, 8000f);
+    lsb = MSA300_MG2G_ACTIVE_TH_8_G;
     break;
 
     case MSA300_RANGE_4_G:
-    offset = clamp<float>(value / MSA300_MG2G_ACTIVE_TH_4_G, 0, 4000f);
+    lsb = MSA300_MG2G_ACTIVE_TH_4_G;
     break;
 
     case MSA300_RANGE_2_G:
-    offset = clamp<float>(value / MSA300_MG2G_ACTIVE_TH_2_G, 0, 2000f);
+    lsb = MSA300_MG2G_ACTIVE_TH_2_G;
     break;
   }
 
-  writeRegister(MSA300_REG_ACTIVE_TH, offset);
+  /* Threshold is given in mg, multipliers are in g */
+  float threshold = clamp<float>(value / (lsb * 1000.0f), 0, 255);
+
+  writeRegister(MSA300_REG_ACTIVE_TH, (uint8_t)threshold);
 }
 
 /**************************************************************************/
@@ -873,8 +1571,8 @@ void MSA300::setActiveThreshold(float value)
 /**************************************************************************/
 void MSA300::setActiveDuration(uint8_t duration)
 {
-  uint8_t reg;
-  value = clamp<uint8_t>(duration - 1, 0, 4);
+  uint8_t reg = 0;
+  uint8_t value = clamp<uint8_t>(duration - 1, 0, 4);
   reg |= value;
 
   writeRegister(MSA300_REG_ACTIVE_DUR, reg);
@@ -890,7 +1588,7 @@ void MSA300::setActiveDuration(uint8_t duration)
 /**************************************************************************/
 void MSA300::setFreefallDuration(uint16_t duration)
 {
-  uint8_t reg;
+  uint8_t reg = 0;
   float dur_f;
   duration = clamp<uint16_t>(duration, 2, 512);
   dur_f = clamp<float>((float)(duration)/2.0f - 1, 0, 256); // avoid rounding the result in between 
@@ -901,34 +1599,19 @@ void MSA300::setFreefallDuration(uint16_t duration)
 
 /**************************************************************************/
 /*!
-    @brief  Set threshold of freefall interrupt. Value can vary from 0 to full
-            scale of each range. Values outside the range will be clamped.
+    @brief  Set threshold of freefall interrupt. Value can vary from 0 to
+            1991 mg in steps of 7.81 mg. Values outside the range will be
+            clamped.
     @param  value
-            Freefall interrupt threshold (0 to full scale)
+            Freefall interrupt threshold in mg
 */
 /**************************************************************************/
 void MSA300::setFreefallThreshold(float value)
 { 
-  float threshold = value / 7.81f;
-  switch(_range) {
-    case MSA300_RANGE_16_G:
-    threshold = clamp<float>(threshold, 0, 16000f);
-    break;
+  /* 7.81 mg per lsb in every range */
+  float threshold = clamp<float>(value / 7.81f, 0, 255);
 
-    case MSA300_RANGE_8_G:
-    threshold = clamp<float>(threshold, 0, 8000f);
-    break;
-
-    case MSA300_RANGE_4_G:
-    threshold = clamp<float>(threshold, 0, 4000f);
-    break;
-
-    case MSA300_RANGE_2_G:
-    threshold = clamp<float>(threshold, 0, 2000f);
-    break;
-  }
-
-  writeRegister(MSA300_REG_FREEFALL_TH, threshold);
+  writeRegister(MSA300_REG_FREEFALL_TH, (uint8_t)threshold);
 }
 
 /**************************************************************************/
@@ -943,16 +1626,16 @@ void MSA300::setFreefallThreshold(float value)
             Freefall hysteresis value (0 to 500 mg in steps of 125 mg)
 */  
 /**************************************************************************/
-void MSA300::setFreefallHysteresis(uint8_t mode, uint8_t value)
+void MSA300::setFreefallHysteresis(uint8_t mode, uint16_t value)
 {
-  uint8_t reg;
-  uint8_t hysteresis = (uint8_t)clamp<uint16_t>(value / 125, 0, 500);
+  uint8_t reg = 0;
+  uint8_t hysteresis = (uint8_t)clamp<uint16_t>(value / 125, 0, 3);
 
-  reg |= (mode << 3);
-  reg &= ~0x3;
+  /* freefall_mode is bit 2, hysteresis bits 0-1 */
+  reg |= (mode & 1) << 2;
   reg |= hysteresis;
 
-  writeRegister(MSA300_REG_FREEFALL_HY);
+  writeRegister(MSA300_REG_FREEFALL_HY, reg);
 }
 
 /**************************************************************************/
@@ -1037,7 +1720,7 @@ void MSA300::setBlocking(orientBlockMode_t mode, float zBlockValue)
             Acceleration struct to be filled with data
 */
 /**************************************************************************/
-void MSA300::getAcceleration(acc_t acceleration) 
+void MSA300::getAcceleration(acc_t *acceleration) 
 {
   //Clear contents
   memset(acceleration, 0, sizeof(acc_t));
@@ -1047,3 +1730,62 @@ void MSA300::getAcceleration(acc_t acceleration)
   acceleration->y = getY() * _multiplier * GRAVITY;
   acceleration->z = getZ() * _multiplier * GRAVITY;
 }
+
+/**************************************************************************/
+/*! 
+    @brief  Get the raw acceleration of all axes in a single burst read.
+    @param  acceleration
+            Raw acceleration struct to be filled with data
+*/
+/**************************************************************************/
+void MSA300::getRawAcceleration(rawAcc_t *acceleration) 
+{
+  uint8_t buffer[6];
+
+  readRegisters(MSA300_REG_ACC_X_LSB, buffer, sizeof(buffer));
+
+  acceleration->x = (int16_t)(buffer[0] | (buffer[1] << 8));
+  acceleration->y = (int16_t)(buffer[2] | (buffer[3] << 8));
+  acceleration->z = (int16_t)(buffer[4] | (buffer[5] << 8));
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Convert a raw sample to acceleration in the configured range.
+    @param  raw
+            Raw acceleration
+    @param  acceleration
+            Acceleration struct to be filled with data
+*/
+/**************************************************************************/
+void MSA300::convertAcceleration(const rawAcc_t *raw, acc_t *acceleration) 
+{
+  float scale = _multiplier * GRAVITY;
+
+  acceleration->x = raw->x * scale;
+  acceleration->y = raw->y * scale;
+  acceleration->z = raw->z * scale;
+}
+
+/**************************************************************************/
+/*! 
+    @brief  Read sample and interrupt status in a single burst
+            (MSA300_REG_ACC_X_LSB to MSA300_REG_ORIENT_STATUS). Meant for
+            servicing the new data interrupt with one transaction.
+            The frame is flagged while the output is still settling.
+    @param  frame
+            Frame struct to be filled with data
+*/
+/**************************************************************************/
+void MSA300::readFrame(frame_t *frame) 
+{
+  uint8_t buffer[MSA300_REG_ORIENT_STATUS - MSA300_REG_ACC_X_LSB + 1];
+
+  readRegisters(MSA300_REG_ACC_X_LSB, buffer, sizeof(buffer));
+
+  frame->acc.x = (int16_t)(buffer[0] | (buffer[1] << 8));
+  frame->acc.y = (int16_t)(buffer[2] | (buffer[3] << 8));
+  frame->acc.z = (int16_t)(buffer[4] | (buffer[5] << 8));
+  memcpy(&frame->interrupts.motion, &buffer[MSA300_REG_MOTION_INT - MSA300_REG_ACC_X_LSB], sizeof(frame->interrupts));
+  frame->settled = settled();
+}
@@ -15,6 +15,8 @@
 */
 /**************************************************************************/
 
+#ifndef MSA300_H
+#define MSA300_H
 
 #if ARDUINO >= 100
  #include "Arduino.h"
@@ -49,8 +51,8 @@
     #define MSA300_REG_ACC_X_MSB            (0x03) ///< X-acceleration MSB (R)
     #define MSA300_REG_ACC_Y_LSB            (0x04) ///< Y-acceleration LSB (R)
     #define MSA300_REG_ACC_Y_MSB            (0x05) ///< Y-acceleration MSB (R)
-    #define MSA300_REG_ACC_Z_LSB            (0x02) ///< X-acceleration LSB (R)
-    #define MSA300_REG_ACC_Z_MSB            (0x03) ///< X-acceleration MSB (R)
+    #define MSA300_REG_ACC_Z_LSB            (0x06) ///< Z-acceleration LSB (R)
+    #define MSA300_REG_ACC_Z_MSB            (0x07) ///< Z-acceleration MSB (R)
     #define MSA300_REG_MOTION_INT           (0x09) ///< Motion interrupt (R)
     #define MSA300_REG_DATA_INT             (0x0A) ///< Data interrupt (R)
     #define MSA300_REG_TAP_ACTIVE_STATUS    (0x0B) ///< Tap status (R)
@@ -77,7 +79,7 @@
     #define MSA300_REG_Z_BLOCK              (0x2D) ///< Z Blocking (R/W)
     #define MSA300_REG_OFFSET_COMP_X        (0x38) ///< X Offset Compensation (R/W)
     #define MSA300_REG_OFFSET_COMP_Y        (0x39) ///< Y Offset Compensation (R/W)
-    #define MSA300_REG_OFFSET_COMP_Z        (0x40) ///< Z Offset Compensation (R/W)
+    #define MSA300_REG_OFFSET_COMP_Z        (0x3A) ///< Z Offset Compensation (R/W)
      
     
 /*=========================================================================*/
@@ -103,6 +105,36 @@
     #define MSA300_MG2G_ACTIVE_TH_8_G      (0.015625)   ///< 15.625mg per lsb
     #define MSA300_MG2G_ACTIVE_TH_4_G      (0.00781)    ///< 7.81mg per lsb
     #define MSA300_MG2G_ACTIVE_TH_2_G      (0.00391)    ///< 3.91mg per lsb
+
+    /* Offset compensation */
+    #define MSA300_OFFSET_MG_PER_LSB       (3.9f)       ///< 3.9mg per lsb, 0 to 994.5mg
+    #define MSA300_CALIBRATION_SAMPLES     (64)         ///< Largest number of samples calibrate() collects
+/*=========================================================================*/
+
+/*=========================================================================
+    TIMING
+    -----------------------------------------------------------------------*/
+    #define MSA300_SOFT_RESET              (0x24)       ///< Value written to SOFT_RESET to reset the chip
+    #define MSA300_RESET_TIME_US           (5000)       ///< Soft reset to first register access
+    #define MSA300_WAKE_TIME_US            (1000)       ///< Mode change to the first conversion
+    #define MSA300_SETTLING_SAMPLES        (2)          ///< Output periods the filters need after a mode or data rate change
+/*=========================================================================*/
+
+/*=========================================================================
+    POWER MODEL
+    Typical values, tune them for a given part
+    -----------------------------------------------------------------------*/
+    #define MSA300_CURRENT_NORMAL_UA       (175.0f)     ///< Supply current in normal mode
+    #define MSA300_CURRENT_SUSPEND_UA      (2.0f)       ///< Supply current in suspend mode
+    #define MSA300_LOW_POWER_WAKE_US       (250)        ///< Front end start up per sample in low power mode
+    #define MSA300_NOISE_NORMAL_UG         (300.0f)     ///< Noise density in normal mode, ug/sqrt(Hz)
+    #define MSA300_NOISE_LOW_POWER_UG      (600.0f)     ///< Noise density in low power mode, ug/sqrt(Hz)
+/*=========================================================================*/
+
+/*=========================================================================
+    REGISTER IMAGE
+    -----------------------------------------------------------------------*/
+    #define MSA300_IMAGE_SIZE              (24)         ///< Writable configuration registers 0x0F-0x3A, in address order
 /*=========================================================================*/
 
 /** Datarate settings. Used with register 0x10 (MSA300_REG_ODR) to set datarate and with register 0x11 (MSA_REG_PWR_MODE_BW) to set Bandwidth */
@@ -146,6 +178,20 @@ typedef enum
   MSA300_MODE_SUSPEND         = 0b11    ///< Suspend/Shutdown mode
 } pwrMode_t;
 
+/** Low power bandwidth settings. Used with register 0x11 (MSA300_REG_PWR_MODE_BW), only apply in low power mode */
+typedef enum
+{
+  MSA300_BW_1_95_HZ           = 0b0010,   ///< 1.95Hz Bandwidth (0b0000 and 0b0001 are the same)
+  MSA300_BW_3_9_HZ            = 0b0011,   ///< 3.9Hz Bandwidth
+  MSA300_BW_7_81_HZ           = 0b0100,   ///< 7.81Hz Bandwidth
+  MSA300_BW_15_63_HZ          = 0b0101,   ///< 15.63Hz Bandwidth
+  MSA300_BW_31_25_HZ          = 0b0110,   ///< 31.25Hz Bandwidth
+  MSA300_BW_62_5_HZ           = 0b0111,   ///< 62.5Hz Bandwidth
+  MSA300_BW_125_HZ            = 0b1000,   ///< 125Hz Bandwidth
+  MSA300_BW_250_HZ            = 0b1001,   ///< 250Hz Bandwidth
+  MSA300_BW_500_HZ            = 0b1010    ///< 500Hz Bandwidth (default value, 0b1011 to 0b1111 are the same)
+} bandwidth_t;
+
 /** Interrupt latch settings. */
 typedef enum
 {
@@ -172,6 +218,21 @@ typedef enum
   MSA300_AXIS_Z               = 0b10    ///< Z axis
 } axis_t;
 
+/** Interrupt sources. Combine with | for routing. Low byte mirrors INT_SET_0, high byte INT_SET_1. */
+typedef enum
+{
+  MSA300_INT_SRC_ACTIVE_X     = 0x0001,   ///< Active interrupt on x axis
+  MSA300_INT_SRC_ACTIVE_Y     = 0x0002,   ///< Active interrupt on y axis
+  MSA300_INT_SRC_ACTIVE_Z     = 0x0004,   ///< Active interrupt on z axis
+  MSA300_INT_SRC_ACTIVE       = 0x0007,   ///< Active interrupt on all axes
+  MSA300_INT_SRC_DOUBLE_TAP   = 0x0010,   ///< Double tap interrupt
+  MSA300_INT_SRC_SINGLE_TAP   = 0x0020,   ///< Single tap interrupt
+  MSA300_INT_SRC_ORIENT       = 0x0040,   ///< Orientation interrupt
+  MSA300_INT_SRC_FREEFALL     = 0x0800,   ///< Freefall interrupt
+  MSA300_INT_SRC_NEW_DATA     = 0x1000,   ///< New data interrupt
+  MSA300_INT_SRC_ALL          = 0x1877    ///< All sources
+} intSource_t;
+
 /** Tap duration settings. */
 typedef enum
 {
@@ -193,35 +254,13 @@ typedef struct
   float z;    ///< Z acceleration
 } acc_t;
 
-/** Interrupt container. If active or tap interrupts are raised, populates intStatus with more info about interrupt. */
+/** Raw acceleration container. Holds the left-aligned 16-bit register words as read from the chip. */
 typedef struct
 {
-  bool orientInt = false;       ///< Orientation interrupt
-  bool sTapInt = false;         ///< Single tap interrupt
-  bool dTapInt = false;         ///< Double tap interrupt
-  bool activeInt = false;       ///< Active interrupt
-  bool freefallInt = false;     ///< Freefall interrupt
-  bool newDataInt = false;      ///< New data interrupt
-
-  /** Optional interrupt status container */
-  union 
-  {
-    /** Interrupt status container */
-    struct 
-    {
-      uint8_t tapSign;          ///< Tap interrupt sign
-      uint8_t tapFirstX;        ///< Tap triggered by x axis
-      uint8_t tapFirstY;        ///< Tap triggered by y axis
-      uint8_t tapFirstZ;        ///< Tap triggered by z axis
-      uint8_t activeSign;       ///< Active interrupt sign
-      uint8_t activeFirstX;     ///< Active interrupt triggered by x axis
-      uint8_t activeFirstY;     ///< Active interrupt triggered by y axis
-      uint8_t activeFirstZ;     ///< Active interrupt triggered by z axis
-    } intStatus;
-
-  };
-
-} interrupt_t;
+  int16_t x;  ///< X acceleration (raw)
+  int16_t y;  ///< Y acceleration (raw)
+  int16_t z;  ///< Z acceleration (raw)
+} rawAcc_t;
 
 /** Z orientation */
 typedef enum 
@@ -247,6 +286,78 @@ typedef struct
 
 } orient_t;
 
+/** Interrupt container. Holds the raw status registers (4 bytes) and decodes them on access.
+    Trivially copyable; use store() and load() to hand it over through a volatile variable. */
+typedef struct interrupt_t
+{
+  uint8_t motion;               ///< MSA300_REG_MOTION_INT
+  uint8_t data;                 ///< MSA300_REG_DATA_INT
+  uint8_t tap;                  ///< MSA300_REG_TAP_ACTIVE_STATUS
+  uint8_t orient;               ///< MSA300_REG_ORIENT_STATUS
+
+  constexpr bool orientInt() const { return (motion >> 6) & 1; }     ///< Orientation interrupt
+  constexpr bool sTapInt() const { return (motion >> 5) & 1; }       ///< Single tap interrupt
+  constexpr bool dTapInt() const { return (motion >> 4) & 1; }       ///< Double tap interrupt
+  constexpr bool activeInt() const { return (motion >> 2) & 1; }     ///< Active interrupt
+  constexpr bool freefallInt() const { return (motion >> 0) & 1; }   ///< Freefall interrupt
+  constexpr bool newDataInt() const { return (data >> 0) & 1; }      ///< New data interrupt
+  constexpr bool any() const { return (motion & 0x75) || (data & 1); } ///< Any interrupt raised
+
+  constexpr bool tapSign() const { return (tap >> 7) & 1; }          ///< Tap interrupt sign
+  constexpr bool tapFirstX() const { return (tap >> 6) & 1; }        ///< Tap triggered by x axis
+  constexpr bool tapFirstY() const { return (tap >> 5) & 1; }        ///< Tap triggered by y axis
+  constexpr bool tapFirstZ() const { return (tap >> 4) & 1; }        ///< Tap triggered by z axis
+  constexpr bool activeSign() const { return (tap >> 3) & 1; }       ///< Active interrupt sign
+  constexpr bool activeFirstX() const { return (tap >> 2) & 1; }     ///< Active interrupt triggered by x axis
+  constexpr bool activeFirstY() const { return (tap >> 1) & 1; }     ///< Active interrupt triggered by y axis
+  constexpr bool activeFirstZ() const { return (tap >> 0) & 1; }     ///< Active interrupt triggered by z axis
+
+  /** Orientation status read with the interrupts */
+  constexpr orient_t orientation() const
+  {
+    return orient_t{(zOrient_t)((orient >> 6) & 1), (xyOrient_t)((orient >> 4) & 0x3)};
+  }
+
+  /** Copy into a volatile instance, e.g. from an ISR */
+  void store(const interrupt_t &value) volatile
+  {
+    motion = value.motion;
+    data = value.data;
+    tap = value.tap;
+    orient = value.orient;
+  }
+
+  /** Copy out of a volatile instance */
+  interrupt_t load() const volatile
+  {
+    interrupt_t value;
+    value.motion = motion;
+    value.data = data;
+    value.tap = tap;
+    value.orient = orient;
+    return value;
+  }
+} interrupt_t;
+
+/** Frame container. Sample and interrupt status read in one burst. */
+typedef struct
+{
+  rawAcc_t    acc;              ///< Raw acceleration
+  interrupt_t interrupts;       ///< Interrupt and orientation status
+  bool        settled;          ///< False while the output settles after a mode or data rate change
+} frame_t;
+
+/** Power configuration, as chosen by optimizePower() or evaluated by estimatePower() */
+typedef struct
+{
+  pwrMode_t   mode;             ///< Power mode
+  dataRate_t  dataRate;         ///< Output data rate
+  bandwidth_t bandwidth;        ///< Low power bandwidth bits
+  float       bandwidthHz;      ///< Usable signal bandwidth
+  float       noiseMg;          ///< Estimated rms noise, including quantization
+  float       currentUa;        ///< Estimated supply current
+} powerConfig_t;
+
 /** Polarity swap */
 typedef enum 
 {
@@ -271,29 +382,52 @@ typedef enum
   ORIENT_Z_BLOCKING_0_2_G     = 0b10    ///< Z blocking or slope in any axis > 0.2g 
 } orientBlockMode_t;
 
+/** Register bus interface. Implement to run the driver over a custom transport or a simulated chip. */
+class MSA300Bus{
+ public:
+  /** Write consecutive registers starting at reg */
+  virtual void write(uint8_t reg, const uint8_t *buffer, uint8_t len) = 0;
+  /** Read consecutive registers starting at reg */
+  virtual void read(uint8_t reg, uint8_t *buffer, uint8_t len) = 0;
+};
+
 /** Class for MSA300 */
 class MSA300{
  public:
   MSA300(int32_t sensorID = -1);
   MSA300(uint8_t clock, uint8_t miso, uint8_t mosi, uint8_t cs, int32_t sensorID = -1);
+  MSA300(MSA300Bus &bus, int32_t sensorID = -1);
 
   bool        begin(void);
+  bool        begin(const uint8_t *image);
+  void        readImage(uint8_t *image);
+  uint8_t     writeImage(const uint8_t *image, const uint8_t *current = NULL);
   void        setRange(range_t range);
   range_t     getRange(void);
   void        setResolution(res_t resolution);
   res_t       getResolution(void);
   void        setDataRate(dataRate_t dataRate);
   dataRate_t  getDataRate(void);
+  void        setBandwidth(bandwidth_t bandwidth);
+  bandwidth_t getBandwidth(void);
   void        setMode(pwrMode_t mode);
   pwrMode_t   getMode(void);
+  bool        estimatePower(pwrMode_t mode, dataRate_t dataRate, bandwidth_t bandwidth, powerConfig_t *config);
+  bool        optimizePower(float bandwidthHz, float noiseMg, powerConfig_t *config = NULL);
+  void        softReset(void);
+  void        suspend(void);
+  uint32_t    resume(void);
+  uint32_t    getWakeLatency(void);
+  bool        settled(void);
   void        setOffset(axis_t axis, float value);
+  float       calibrate(axis_t axis, bool inverted = false, uint8_t samples = MSA300_CALIBRATION_SAMPLES);
   void        setTapThreshold(float value);
-  void        setTapDuration(tapDuration_t duration, uin8_t quiet, uint8_t shock);
+  void        setTapDuration(tapDuration_t duration, uint8_t quiet, uint8_t shock);
   void        setActiveThreshold(float value);
   void        setActiveDuration(uint8_t duration);
   void        setFreefallDuration(uint16_t duration);
   void        setFreefallThreshold(float value);
-  void        setFreefallHysteresis(uint8_t mode, uint8_t value);
+  void        setFreefallHysteresis(uint8_t mode, uint16_t value);
   void        swapPolarity(pol_t polarity);
   void        setOrientMode(orientMode_t mode);
   void        setOrientHysteresis(float value);
@@ -303,24 +437,40 @@ class MSA300{
   void        clearInterrupts(void);
   interrupt_t checkInterrupts(void);
   void        setInterruptLatch(intMode_t mode);
-  void        enableActiveInterrupt(axis_t axis, uint8_t interrupt);
-  void        enableFreefallInterrupt(uint8_t interrupt);
-  void        enableOrientationInterrupt(uint8_t interrupt);
-  void        enableSingleTapInterrupt(uint8_t interrupt);
-  void        enableDoubleTapInterrupt(uint8_t interrupt);
-  void        enableNewDataInterrupt(uint8_t interrupt);
+  intMode_t   getInterruptLatch(void);
+  bool        enableActiveInterrupt(axis_t axis, uint8_t interrupt);
+  bool        enableFreefallInterrupt(uint8_t interrupt);
+  bool        enableOrientationInterrupt(uint8_t interrupt);
+  bool        enableSingleTapInterrupt(uint8_t interrupt);
+  bool        enableDoubleTapInterrupt(uint8_t interrupt);
+  bool        enableNewDataInterrupt(uint8_t interrupt);
+  bool        routeInterrupts(uint16_t int1, uint16_t int2);
+  bool        enableInterrupt(uint16_t sources, uint8_t interrupt);
+  void        disableInterrupt(uint16_t sources);
+  uint16_t    getRoutedInterrupts(uint8_t interrupt);
  
-  void        getAcceleration(acc_t acceleration);
+  void        getAcceleration(acc_t *acceleration);
+  void        getRawAcceleration(rawAcc_t *acceleration);
+  void        convertAcceleration(const rawAcc_t *raw, acc_t *acceleration);
+  void        readFrame(frame_t *frame);
   orient_t    checkOrientation(void);
 
   uint8_t     getPartID(void);
+  int32_t     getSensorID(void);
   void        writeRegister(uint8_t reg, uint8_t value);
+  void        writeRegisters(uint8_t reg, const uint8_t *buffer, uint8_t len);
   uint8_t     readRegister(uint8_t reg);
   int16_t     read16(uint8_t reg);
+  void        readRegisters(uint8_t reg, uint8_t *buffer, uint8_t len);
 
   int16_t     getX(void), getY(void), getZ(void);
  private:
 
+  bool            connect(void);
+  uint8_t         packImage(const uint8_t *regs, uint8_t *image, uint8_t runs);
+  void            loadImage(const uint8_t *image);
+  void            updateMultiplier(void);
+  void            startSettling(bool wake);
   inline uint8_t  i2cread(void);
   inline void     i2cwrite(uint8_t x);
   
@@ -330,8 +480,17 @@ class MSA300{
   float _multiplier;
   res_t _res;
   pwrMode_t _mode;
+  pwrMode_t _activeMode;
+  dataRate_t _dataRate;
+  bandwidth_t _bandwidth;
+  bool    _settling;
+  uint32_t _settleStart;
+  uint32_t _settleTime;
   uint8_t _clk, _do, _di, _cs;
   bool    _i2c;
+  MSA300Bus *_bus;
+  intMode_t _latch;
+  uint16_t _int1Sources, _int2Sources;
 };
 
 /*! 
@@ -356,4 +515,105 @@ T clamp(T value, T min, T max)
   }
 
   return value;
-}
\ No newline at end of file
+}
+
+/*! 
+    @brief  Get the output data rate in Hz.
+    @param  dataRate
+            Output data rate setting
+    @return Output data rate in Hz
+*/
+inline float dataRateToHz(dataRate_t dataRate)
+{
+  switch(dataRate) {
+    case MSA300_DATARATE_1_HZ:
+      return 1.0f;
+    case MSA300_DATARATE_1_95_HZ:
+      return 1.95f;
+    case MSA300_DATARATE_3_9_HZ:
+      return 3.9f;
+    case MSA300_DATARATE_7_81_HZ:
+      return 7.81f;
+    case MSA300_DATARATE_15_63_HZ:
+      return 15.63f;
+    case MSA300_DATARATE_31_25_HZ:
+      return 31.25f;
+    case MSA300_DATARATE_62_5_HZ:
+      return 62.5f;
+    case MSA300_DATARATE_125_HZ:
+      return 125.0f;
+    case MSA300_DATARATE_250_HZ:
+      return 250.0f;
+    case MSA300_DATARATE_500_HZ:
+      return 500.0f;
+    case MSA300_DATARATE_1000_HZ:
+    default:
+      return 1000.0f;
+  }
+}
+
+/*! 
+    @brief  Get the low power bandwidth in Hz.
+    @param  bandwidth
+            Low power bandwidth setting
+    @return Bandwidth in Hz
+*/
+inline float bandwidthToHz(bandwidth_t bandwidth)
+{
+  if (bandwidth <= MSA300_BW_1_95_HZ) {
+    return 1.95f;
+  }
+  if (bandwidth >= MSA300_BW_500_HZ) {
+    return 500.0f;
+  }
+  /* 3.9 Hz doubles with every step */
+  return 3.90625f * (1 << (bandwidth - MSA300_BW_3_9_HZ));
+}
+
+/*! 
+    @brief  Get the number of significant bits of a raw sample.
+    @param  resolution
+            Measurement resolution
+    @return Bits per axis (8, 12 or 14)
+*/
+inline uint8_t resolutionBits(res_t resolution)
+{
+  switch(resolution) {
+    case MSA300_RES_8_BIT:
+      return 8;
+    case MSA300_RES_12_BIT:
+      return 12;
+    case MSA300_RES_14_BIT:
+    default:
+      return 14;
+  }
+}
+
+/*! 
+    @brief  Integer square root.
+    @param  value
+            Value
+    @return Square root rounded down
+*/
+inline uint32_t squareRoot(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit = (uint32_t)1 << 30;
+
+  while(bit > value) {
+    bit >>= 2;
+  }
+  while(bit) {
+    if(value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return root;
+}
+
+#endif // MSA300_H
@@ -0,0 +1,330 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Activity.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Step counter and activity classifier for MSA300
+*/
+/**************************************************************************/
+#include "MSA300Activity.h"
+
+static_assert(sizeof(MSA300Activity) <= MSA300_ACTIVITY_STATE_MAX, "Activity state exceeds its memory budget");
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new step counter and activity classifier
+*/
+/**************************************************************************/
+MSA300Activity::MSA300Activity(void)
+{
+  _periodMs = 0;
+  _scale = 0;
+  _windowSamples = 0;
+  setThresholds(120, 12, 150, 600);
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Configure for a sample stream and start over
+    @param  dataRate
+            Output data rate, MSA300_DATARATE_31_25_HZ or
+            MSA300_DATARATE_62_5_HZ
+    @param  range
+            Range the samples are measured in. Any resolution works.
+    @return False if the data rate is not supported
+*/
+/**************************************************************************/
+bool MSA300Activity::begin(dataRate_t dataRate, range_t range)
+{
+  /* Gravity filter time constant about 1 s, smoothing cutoff about 4 Hz */
+  switch (dataRate) {
+    case MSA300_DATARATE_31_25_HZ:
+      _periodMs = 32;
+      _gravityShift = 5;
+      _smoothShift = 1;
+      break;
+    case MSA300_DATARATE_62_5_HZ:
+      _periodMs = 16;
+      _gravityShift = 6;
+      _smoothShift = 2;
+      break;
+    default:
+      _periodMs = 0;
+      return false;
+  }
+
+  /* mg per 12 bit count in Q8 */
+  _scale = 250 << range;
+  _windowSamples = MSA300_ACTIVITY_WINDOW_MS / _periodMs;
+  reset();
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the classification thresholds
+    @param  stepMg
+            Smallest peak to peak swing of the dynamic magnitude that is
+            a step
+    @param  restMg
+            Mean dynamic magnitude below which the window is rest
+    @param  vehicleMg
+            Mean dynamic magnitude below which a window without steps is
+            vehicle
+    @param  runMg
+            Mean dynamic magnitude above which stepping is running,
+            whatever the cadence
+*/
+/**************************************************************************/
+void MSA300Activity::setThresholds(uint16_t stepMg, uint16_t restMg, uint16_t vehicleMg, uint16_t runMg)
+{
+  _stepMg = stepMg;
+  _restMg = restMg;
+  _vehicleMg = vehicleMg;
+  _runMg = runMg;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Clear the step count and the filter states
+*/
+/**************************************************************************/
+void MSA300Activity::reset(void)
+{
+  _gravity = 0;
+  _smooth = 0;
+  _primed = false;
+
+  _above = false;
+  _high = 0;
+  _low = 0;
+  _swing = 0;
+  _sinceStep = 0;
+  _interval = 0;
+  _regular = 0;
+  _steps = 0;
+
+  _windowCount = 0;
+  _windowSum = 0;
+  _windowSteps = 0;
+  _intensity = 0;
+  _activity = MSA300_ACTIVITY_UNKNOWN;
+  _candidate = MSA300_ACTIVITY_UNKNOWN;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add one sample
+    @param  sample
+            Raw sample
+    @return True if the sample completed a classification window
+*/
+/**************************************************************************/
+bool MSA300Activity::update(const rawAcc_t *sample)
+{
+  return _periodMs && update(sample, 1) == 1 && _windowCount == 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add a batch of samples. Stops after the sample that completes
+            a classification window, so that no change of activity is
+            missed.
+    @param  samples
+            Raw samples
+    @param  count
+            Number of samples
+    @return Number of samples used
+*/
+/**************************************************************************/
+uint16_t MSA300Activity::update(const rawAcc_t *samples, uint16_t count)
+{
+  if (_periodMs == 0) {
+    return count;
+  }
+
+  for (uint16_t i = 0; i < count; i++) {
+    /* Magnitude in mg, from the top 12 bits of every resolution */
+    int32_t x = samples[i].x >> 4;
+    int32_t y = samples[i].y >> 4;
+    int32_t z = samples[i].z >> 4;
+    int32_t mg = (int32_t)((squareRoot((uint32_t)(x * x + y * y + z * z)) * _scale) >> 8);
+
+    if (!_primed) {
+      _gravity = mg << 4;
+      _primed = true;
+    }
+    _gravity += ((mg << 4) - _gravity) >> _gravityShift;
+    int32_t dynamic = (mg << 4) - _gravity;
+    _smooth += (dynamic - _smooth) >> _smoothShift;
+    int16_t value = (int16_t)(_smooth >> 4);
+
+    _windowSum += (uint32_t)((dynamic < 0 ? -dynamic : dynamic) >> 4);
+
+    if (_sinceStep < 0xFFFF) {
+      _sinceStep++;
+    }
+    if ((uint32_t)_sinceStep * _periodMs > MSA300_ACTIVITY_STEP_MAX_MS) {
+      _regular = 0;
+      _swing = 0;
+    }
+
+    /* Hysteresis follows the recent step swing, so heel strikes of a run
+       do not count twice */
+    uint16_t swing = (_swing > _stepMg) ? _swing : _stepMg;
+    int16_t hysteresis = swing / 4;
+
+    if (_above) {
+      _high = (value > _high) ? value : _high;
+      if (value < -hysteresis) {
+        _above = false;
+        _low = value;
+      }
+    } else {
+      _low = (value < _low) ? value : _low;
+      if (value > hysteresis) {
+        _above = true;
+        if (_high - _low >= (int16_t)_stepMg) {
+          step();
+        }
+        _high = value;
+      }
+    }
+
+    if (++_windowCount >= _windowSamples) {
+      finishWindow();
+      return i + 1;
+    }
+  }
+
+  return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Handle one swing of the dynamic magnitude
+*/
+/**************************************************************************/
+void MSA300Activity::step(void)
+{
+  uint32_t interval = (uint32_t)_sinceStep * _periodMs;
+
+  /* Too quick to be a step, part of the current one */
+  if (interval < MSA300_ACTIVITY_STEP_MIN_MS) {
+    return;
+  }
+  _sinceStep = 0;
+
+  /* First swing after a pause only starts the clock */
+  if (interval > MSA300_ACTIVITY_STEP_MAX_MS) {
+    _regular = 0;
+    return;
+  }
+
+  uint16_t swing = _high - _low;
+  if (_regular == 0) {
+    _swing = swing;
+    _interval = interval;
+  } else {
+    _swing += ((int32_t)swing - _swing) / 4;
+    _interval += ((int32_t)interval - _interval) / 4;
+  }
+
+  if (_regular < MSA300_ACTIVITY_REGULATION) {
+    if (++_regular == MSA300_ACTIVITY_REGULATION) {
+      _steps += MSA300_ACTIVITY_REGULATION;
+      _windowSteps += MSA300_ACTIVITY_REGULATION;
+    }
+  } else {
+    _steps++;
+    _windowSteps++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Classify the window and start a new one
+*/
+/**************************************************************************/
+void MSA300Activity::finishWindow(void)
+{
+  activity_t activity;
+
+  _intensity = (uint16_t)(_windowSum / _windowCount);
+
+  if (_intensity < _restMg) {
+    activity = MSA300_ACTIVITY_REST;
+  } else if (_windowSteps >= 2 && _regular >= MSA300_ACTIVITY_REGULATION) {
+    activity = (cadence() >= 140 || _intensity >= _runMg) ? MSA300_ACTIVITY_RUN : MSA300_ACTIVITY_WALK;
+  } else if (_intensity < _vehicleMg) {
+    activity = MSA300_ACTIVITY_VEHICLE;
+  } else {
+    activity = MSA300_ACTIVITY_UNKNOWN;
+  }
+
+  /* Report a change only after two windows agree */
+  if (activity != _activity && activity == _candidate) {
+    _activity = activity;
+  }
+  _candidate = activity;
+
+  _windowCount = 0;
+  _windowSum = 0;
+  _windowSteps = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of counted steps
+    @return Steps since begin() or reset()
+*/
+/**************************************************************************/
+uint32_t MSA300Activity::steps(void)
+{
+  return _steps;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the current activity
+    @return Activity of the last two windows
+*/
+/**************************************************************************/
+activity_t MSA300Activity::activity(void)
+{
+  return _activity;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the step cadence
+    @return Steps per minute, 0 when not stepping
+*/
+/**************************************************************************/
+uint16_t MSA300Activity::cadence(void)
+{
+  if (_regular < MSA300_ACTIVITY_REGULATION || _interval == 0) {
+    return 0;
+  }
+
+  return (uint16_t)(60000UL / _interval);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the intensity of the last window
+    @return Mean dynamic magnitude in mg
+*/
+/**************************************************************************/
+uint16_t MSA300Activity::intensity(void)
+{
+  return _intensity;
+}
@@ -0,0 +1,108 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Activity.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Step counter and activity classifier for low power sample streams.
+
+    Runs on the magnitude of raw samples at 31.25 or 62.5 Hz, all in
+    integer arithmetic. Gravity is tracked with a slow low pass filter.
+    A step is one swing of the smoothed dynamic magnitude above and below
+    an adaptive threshold, at 0.5 to 4 steps per second. Steps are only
+    counted after a run of MSA300_ACTIVITY_REGULATION regular steps, so
+    occasional shakes are ignored. Every two seconds the mean dynamic
+    magnitude and the step cadence are used to classify the window as
+    rest, walk, run or vehicle. A new class has to hold for two windows
+    before it is reported. The whole state fits in
+    MSA300_ACTIVITY_STATE_MAX bytes.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_ACTIVITY_H
+#define MSA300_ACTIVITY_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    ACTIVITY
+    -----------------------------------------------------------------------*/
+    #define MSA300_ACTIVITY_STATE_MAX       (256)     ///< Upper bound of sizeof(MSA300Activity)
+    #define MSA300_ACTIVITY_WINDOW_MS       (2000)    ///< Classification window
+    #define MSA300_ACTIVITY_REGULATION      (4)       ///< Regular steps needed before counting starts
+    #define MSA300_ACTIVITY_STEP_MIN_MS     (250)     ///< Shortest step interval
+    #define MSA300_ACTIVITY_STEP_MAX_MS     (2000)    ///< Longest step interval
+/*=========================================================================*/
+
+/** Activity classes */
+typedef enum
+{
+  MSA300_ACTIVITY_UNKNOWN     = 0,    ///< Not classified yet, or motion without steps
+  MSA300_ACTIVITY_REST        = 1,    ///< No motion
+  MSA300_ACTIVITY_WALK        = 2,    ///< Walking
+  MSA300_ACTIVITY_RUN         = 3,    ///< Running
+  MSA300_ACTIVITY_VEHICLE     = 4     ///< Vibration without steps
+} activity_t;
+
+/** Class for counting steps and classifying activity. Storage is static, nothing is allocated. */
+class MSA300Activity{
+ public:
+  MSA300Activity(void);
+
+  bool        begin(dataRate_t dataRate, range_t range);
+  void        setThresholds(uint16_t stepMg, uint16_t restMg, uint16_t vehicleMg, uint16_t runMg);
+  void        reset(void);
+
+  bool        update(const rawAcc_t *sample);
+  uint16_t    update(const rawAcc_t *samples, uint16_t count);
+
+  uint32_t    steps(void);
+  activity_t  activity(void);
+  uint16_t    cadence(void);
+  uint16_t    intensity(void);
+
+ private:
+  void        step(void);
+  void        finishWindow(void);
+
+  /* Configuration */
+  uint8_t     _periodMs;
+  uint8_t     _gravityShift;
+  uint8_t     _smoothShift;
+  uint16_t    _scale;
+  uint16_t    _windowSamples;
+  uint16_t    _stepMg;
+  uint16_t    _restMg;
+  uint16_t    _vehicleMg;
+  uint16_t    _runMg;
+
+  /* Filters, in mg << 4 */
+  int32_t     _gravity;
+  int32_t     _smooth;
+  bool        _primed;
+
+  /* Step detection */
+  bool        _above;
+  int16_t     _high;
+  int16_t     _low;
+  uint16_t    _swing;
+  uint16_t    _sinceStep;
+  uint16_t    _interval;
+  uint8_t     _regular;
+  uint32_t    _steps;
+
+  /* Classification */
+  uint16_t    _windowCount;
+  uint32_t    _windowSum;
+  uint8_t     _windowSteps;
+  uint16_t    _intensity;
+  activity_t  _activity;
+  activity_t  _candidate;
+};
+
+#endif // MSA300_ACTIVITY_H
@@ -0,0 +1,188 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Buffer.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Fixed-capacity ring buffer for raw MSA300 samples
+*/
+/**************************************************************************/
+#include "MSA300Buffer.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new ring buffer on top of caller supplied storage
+    @param  storage
+            Array of at least capacity samples
+    @param  capacity
+            Number of samples the storage can hold
+*/
+/**************************************************************************/
+MSA300Buffer::MSA300Buffer(rawAcc_t *storage, uint16_t capacity)
+{
+  _storage = storage;
+  _capacity = clamp<uint16_t>(capacity, 0, 32768);
+  _head = 0;
+  _tail = 0;
+  _written = 0;
+  _read = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Append a sample to the buffer
+    @param  sample
+            Sample to be stored
+    @retval True
+            Sample was stored
+    @retval False
+            Buffer was full, sample was dropped
+*/
+/**************************************************************************/
+bool MSA300Buffer::push(const rawAcc_t *sample)
+{
+  if (full()) {
+    return false;
+  }
+
+  _storage[_head] = *sample;
+  _head = (_head + 1 == _capacity) ? 0 : _head + 1;
+  _written = _written + 1;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Remove the oldest sample from the buffer
+    @param  sample
+            Sample struct to be filled with data
+    @retval True
+            Sample was returned
+    @retval False
+            Buffer was empty
+*/
+/**************************************************************************/
+bool MSA300Buffer::pop(rawAcc_t *sample)
+{
+  if (available() == 0) {
+    return false;
+  }
+
+  *sample = _storage[_tail];
+  consume(1);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read a sample without removing it
+    @param  index
+            Position counted from the oldest sample
+    @param  sample
+            Sample struct to be filled with data
+    @return True if index was inside the buffer
+*/
+/**************************************************************************/
+bool MSA300Buffer::peek(uint16_t index, rawAcc_t *sample)
+{
+  if (index >= available()) {
+    return false;
+  }
+
+  uint32_t position = (uint32_t)_tail + index;
+  if (position >= _capacity) {
+    position -= _capacity;
+  }
+  *sample = _storage[position];
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the oldest samples that are stored contiguously in memory.
+            Call consume() after the samples have been used. Two calls are
+            needed to drain a buffer that has wrapped around.
+    @param  samples
+            Set to point at the oldest sample
+    @return Number of contiguous samples
+*/
+/**************************************************************************/
+uint16_t MSA300Buffer::readSpan(const rawAcc_t **samples)
+{
+  uint16_t count = available();
+  uint16_t untilEnd = _capacity - _tail;
+
+  *samples = &_storage[_tail];
+
+  return (count < untilEnd) ? count : untilEnd;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop the oldest samples from the buffer
+    @param  count
+            Number of samples to drop. Clamped to the number stored.
+*/
+/**************************************************************************/
+void MSA300Buffer::consume(uint16_t count)
+{
+  count = clamp<uint16_t>(count, 0, available());
+
+  uint32_t tail = (uint32_t)_tail + count;
+  if (tail >= _capacity) {
+    tail -= _capacity;
+  }
+  _tail = tail;
+  _read = _read + count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop all samples. Consumer side operation.
+*/
+/**************************************************************************/
+void MSA300Buffer::clear(void)
+{
+  consume(available());
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of stored samples
+    @return Number of samples
+*/
+/**************************************************************************/
+uint16_t MSA300Buffer::available(void)
+{
+  return (uint16_t)(_written - _read);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the capacity of the buffer
+    @return Maximum number of samples
+*/
+/**************************************************************************/
+uint16_t MSA300Buffer::capacity(void)
+{
+  return _capacity;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if the buffer is full
+    @return True if no more samples fit
+*/
+/**************************************************************************/
+bool MSA300Buffer::full(void)
+{
+  return available() >= _capacity;
+}
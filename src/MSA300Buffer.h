@@ -0,0 +1,49 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Buffer.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Fixed-capacity ring buffer for raw MSA300 samples
+*/
+/**************************************************************************/
+
+#ifndef MSA300_BUFFER_H
+#define MSA300_BUFFER_H
+
+#include "MSA300.h"
+
+/** Ring buffer of raw samples. Storage is supplied by the caller, so the buffer never allocates. 
+    Safe for one producer (e.g. an ISR) and one consumer, as long as the 16-bit counters are
+    read atomically (on 8-bit parts, call consumer functions with interrupts disabled).
+    Capacity is limited to 32768 samples. */
+class MSA300Buffer{
+ public:
+  MSA300Buffer(rawAcc_t *storage, uint16_t capacity);
+
+  bool        push(const rawAcc_t *sample);
+  bool        pop(rawAcc_t *sample);
+  bool        peek(uint16_t index, rawAcc_t *sample);
+  uint16_t    readSpan(const rawAcc_t **samples);
+  void        consume(uint16_t count);
+  void        clear(void);
+
+  uint16_t    available(void);
+  uint16_t    capacity(void);
+  bool        full(void);
+
+ private:
+  rawAcc_t *_storage;
+  uint16_t _capacity;
+  uint16_t _head;
+  uint16_t _tail;
+  volatile uint16_t _written;
+  volatile uint16_t _read;
+};
+
+#endif // MSA300_BUFFER_H
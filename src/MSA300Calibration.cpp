@@ -0,0 +1,357 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Calibration.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Six-position calibration for MSA300
+*/
+/**************************************************************************/
+#include "MSA300Calibration.h"
+
+#include <math.h>
+
+/** Serialized coefficients. All fields are little endian. */
+typedef struct
+{
+  char     magic[4];            ///< MSA300_CALIBRATION_MAGIC
+  uint8_t  version;             ///< MSA300_CALIBRATION_VERSION
+  uint8_t  reserved[3];         ///< Reserved, written as zero
+  int32_t  sensorID;            ///< ID of the calibrated sensor
+  float    matrix[9];           ///< Row major correction matrix
+  float    bias[3];             ///< Bias in mg
+} calibrationBlob_t;
+
+static_assert(sizeof(calibrationBlob_t) == MSA300_CALIBRATION_BLOB_SIZE, "Unexpected calibration blob size");
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new calibration procedure. Does not touch the
+            bus, call begin() once the sensor is running.
+    @param  accel
+            Sensor to calibrate
+*/
+/**************************************************************************/
+MSA300Calibration::MSA300Calibration(MSA300 &accel)
+{
+  _accel = &accel;
+  _mgPerLsb = 0;
+  memset(_sum, 0, sizeof(_sum));
+  memset(_count, 0, sizeof(_count));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start over. Takes the range the samples will be measured in
+            from the sensor, do not change it before solve().
+*/
+/**************************************************************************/
+void MSA300Calibration::begin(void)
+{
+  _mgPerLsb = (float)(2000 << _accel->getRange()) / 32768.0f;
+  memset(_sum, 0, sizeof(_sum));
+  memset(_count, 0, sizeof(_count));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add samples measured at rest in one position
+    @param  position
+            Position the samples were measured in
+    @param  samples
+            Raw samples
+    @param  count
+            Number of samples
+*/
+/**************************************************************************/
+void MSA300Calibration::add(position_t position, const rawAcc_t *samples, uint16_t count)
+{
+  for (uint16_t i = 0; i < count; i++) {
+    _sum[position][0] += samples[i].x;
+    _sum[position][1] += samples[i].y;
+    _sum[position][2] += samples[i].z;
+  }
+  _count[position] += count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read samples from the sensor at the current data rate, with
+            the device at rest in one position
+    @param  position
+            Position the device is in
+    @param  samples
+            Number of samples
+*/
+/**************************************************************************/
+void MSA300Calibration::collect(position_t position, uint16_t samples)
+{
+  uint32_t period = (uint32_t)(1000.0f / dataRateToHz(_accel->getDataRate())) + 1;
+
+  /* Skip the sample that may still be from the previous position */
+  delay(period);
+  for (uint16_t i = 0; i < samples; i++) {
+    rawAcc_t sample;
+
+    delay(period);
+    _accel->getRawAcceleration(&sample);
+    add(position, &sample, 1);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if all six positions have samples
+    @return True if solve() can run
+*/
+/**************************************************************************/
+bool MSA300Calibration::complete(void)
+{
+  for (uint8_t p = 0; p < 6; p++) {
+    if (_count[p] == 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Estimate the correction matrix and bias
+    @param  calibration
+            Coefficients to fill, keyed by the sensor ID
+    @param  residual
+            If not NULL, set to the RMS error in mg of the corrected
+            position means against the ideal +-1 g
+    @return False if begin() was not called, a position is missing or
+            the axes are degenerate
+*/
+/**************************************************************************/
+bool MSA300Calibration::solve(calibration_t *calibration, float *residual)
+{
+  float mean[6][3];
+  float bias[3];
+  float a[9];
+
+  if (_mgPerLsb == 0 || !complete()) {
+    return false;
+  }
+
+  for (uint8_t p = 0; p < 6; p++) {
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      mean[p][axis] = (float)_sum[p][axis] / _count[p] * _mgPerLsb;
+    }
+  }
+
+  /* Gravity cancels over the six positions, so their mean is the bias.
+     Half the up - down difference is the response to 1 g of that axis. */
+  for (uint8_t row = 0; row < 3; row++) {
+    bias[row] = 0;
+    for (uint8_t p = 0; p < 6; p++) {
+      bias[row] += mean[p][row];
+    }
+    bias[row] /= 6;
+
+    for (uint8_t col = 0; col < 3; col++) {
+      a[row * 3 + col] = (mean[2 * col][row] - mean[2 * col + 1][row]) / 2000.0f;
+    }
+  }
+
+  /* Inverse by cofactors */
+  float *m = calibration->matrix;
+  m[0] = a[4] * a[8] - a[5] * a[7];
+  m[1] = a[2] * a[7] - a[1] * a[8];
+  m[2] = a[1] * a[5] - a[2] * a[4];
+  m[3] = a[5] * a[6] - a[3] * a[8];
+  m[4] = a[0] * a[8] - a[2] * a[6];
+  m[5] = a[2] * a[3] - a[0] * a[5];
+  m[6] = a[3] * a[7] - a[4] * a[6];
+  m[7] = a[1] * a[6] - a[0] * a[7];
+  m[8] = a[0] * a[4] - a[1] * a[3];
+
+  float det = a[0] * m[0] + a[1] * m[3] + a[2] * m[6];
+  if (fabsf(det) < 0.1f) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 9; i++) {
+    m[i] /= det;
+  }
+  memcpy(calibration->bias, bias, sizeof(bias));
+  calibration->sensorID = _accel->getSensorID();
+
+  if (residual) {
+    float sum = 0;
+    for (uint8_t p = 0; p < 6; p++) {
+      for (uint8_t row = 0; row < 3; row++) {
+        float value = 0;
+        for (uint8_t col = 0; col < 3; col++) {
+          value += m[row * 3 + col] * (mean[p][col] - bias[col]);
+        }
+        float expected = (row == p / 2) ? ((p & 1) ? -1000.0f : 1000.0f) : 0.0f;
+        sum += (value - expected) * (value - expected);
+      }
+    }
+    *residual = sqrtf(sum / 18);
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Serialize coefficients for storage
+    @param  calibration
+            Coefficients
+    @param  buffer
+            Destination
+    @param  size
+            Size of the destination, at least MSA300_CALIBRATION_BLOB_SIZE
+    @return Number of bytes written, 0 if the buffer is too small
+*/
+/**************************************************************************/
+uint16_t MSA300Calibration::serialize(const calibration_t *calibration, uint8_t *buffer, uint16_t size)
+{
+  calibrationBlob_t blob;
+
+  if (size < sizeof(blob)) {
+    return 0;
+  }
+
+  memset(&blob, 0, sizeof(blob));
+  memcpy(blob.magic, MSA300_CALIBRATION_MAGIC, sizeof(blob.magic));
+  blob.version = MSA300_CALIBRATION_VERSION;
+  blob.sensorID = calibration->sensorID;
+  memcpy(blob.matrix, calibration->matrix, sizeof(blob.matrix));
+  memcpy(blob.bias, calibration->bias, sizeof(blob.bias));
+  memcpy(buffer, &blob, sizeof(blob));
+
+  return sizeof(blob);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Restore serialized coefficients
+    @param  buffer
+            Serialized coefficients
+    @param  size
+            Size of the buffer
+    @param  sensorID
+            Sensor the coefficients must belong to
+    @param  calibration
+            Coefficients to fill
+    @return False if the buffer does not hold coefficients of this sensor
+*/
+/**************************************************************************/
+bool MSA300Calibration::deserialize(const uint8_t *buffer, uint16_t size, int32_t sensorID, calibration_t *calibration)
+{
+  calibrationBlob_t blob;
+
+  if (size < sizeof(blob)) {
+    return false;
+  }
+
+  memcpy(&blob, buffer, sizeof(blob));
+  if (memcmp(blob.magic, MSA300_CALIBRATION_MAGIC, sizeof(blob.magic)) != 0 ||
+      blob.version != MSA300_CALIBRATION_VERSION || blob.sensorID != sensorID) {
+    return false;
+  }
+
+  calibration->sensorID = blob.sensorID;
+  memcpy(calibration->matrix, blob.matrix, sizeof(blob.matrix));
+  memcpy(calibration->bias, blob.bias, sizeof(blob.bias));
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new correction kernel. Passes samples through
+            until begin() succeeds.
+*/
+/**************************************************************************/
+MSA300Correction::MSA300Correction(void)
+{
+  _enabled = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Convert coefficients to fixed point for one range
+    @param  calibration
+            Coefficients
+    @param  range
+            Range the samples will be measured in
+    @return False if a row of the matrix sums to 2 or more in absolute
+            value, which Q14 can not hold without overflow
+*/
+/**************************************************************************/
+bool MSA300Correction::begin(const calibration_t *calibration, range_t range)
+{
+  /* Works on 14 bit values, the resolution of the finest mode */
+  float lsbPerMg = 8192.0f / (float)(2000 << range);
+
+  _enabled = false;
+  for (uint8_t row = 0; row < 3; row++) {
+    float sum = 0;
+    for (uint8_t col = 0; col < 3; col++) {
+      sum += fabsf(calibration->matrix[row * 3 + col]);
+    }
+    if (sum >= 2.0f) {
+      return false;
+    }
+  }
+
+  for (uint8_t i = 0; i < 9; i++) {
+    _matrix[i] = (int16_t)lroundf(calibration->matrix[i] * 16384.0f);
+  }
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    _bias[axis] = (int16_t)clamp<float>(lroundf(calibration->bias[axis] * lsbPerMg), -8192, 8191);
+  }
+  _enabled = true;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Correct a block of raw samples. Output is raw samples in the
+            same range, so it can go anywhere raw samples go.
+    @param  samples
+            Raw samples
+    @param  corrected
+            Corrected samples, may be the same array as samples
+    @param  count
+            Number of samples
+*/
+/**************************************************************************/
+void MSA300Correction::apply(const rawAcc_t *samples, rawAcc_t *corrected, uint16_t count)
+{
+  if (!_enabled) {
+    if (corrected != samples) {
+      memcpy(corrected, samples, count * sizeof(rawAcc_t));
+    }
+    return;
+  }
+
+  const int16_t *m = _matrix;
+  for (uint16_t i = 0; i < count; i++) {
+    /* Row sums below 2 keep every product sum inside 31 bits */
+    int32_t x = (samples[i].x >> 2) - _bias[0];
+    int32_t y = (samples[i].y >> 2) - _bias[1];
+    int32_t z = (samples[i].z >> 2) - _bias[2];
+
+    int32_t cx = (m[0] * x + m[1] * y + m[2] * z + (1 << 13)) >> 14;
+    int32_t cy = (m[3] * x + m[4] * y + m[5] * z + (1 << 13)) >> 14;
+    int32_t cz = (m[6] * x + m[7] * y + m[8] * z + (1 << 13)) >> 14;
+
+    corrected[i].x = (int16_t)(clamp<int32_t>(cx, -8192, 8191) * 4);
+    corrected[i].y = (int16_t)(clamp<int32_t>(cy, -8192, 8191) * 4);
+    corrected[i].z = (int16_t)(clamp<int32_t>(cz, -8192, 8191) * 4);
+  }
+}
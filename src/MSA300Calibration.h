@@ -0,0 +1,91 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Calibration.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Six-position scale and cross-axis calibration.
+
+    The sensor is modelled as raw = A * g + b, where A holds the per-axis
+    gains and the misalignment between axes. The mean reading is measured
+    with each axis pointing up and down. The bias b is the mean of the six
+    positions, and each column of A is half the difference between the
+    up and down readings of that axis. The correction matrix is the
+    inverse of A. MSA300Correction applies it in Q14 fixed point to whole
+    blocks of raw samples, at nine multiplies per sample.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_CALIBRATION_H
+#define MSA300_CALIBRATION_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    CALIBRATION
+    -----------------------------------------------------------------------*/
+    #define MSA300_CALIBRATION_MAGIC        "MSAC"    ///< Serialized coefficients magic
+    #define MSA300_CALIBRATION_VERSION      (1)       ///< Serialized coefficients format version
+    #define MSA300_CALIBRATION_BLOB_SIZE    (60)      ///< Size of serialized coefficients in bytes
+/*=========================================================================*/
+
+/** Calibration positions. The named axis points up (reads +1 g) or down. */
+typedef enum
+{
+  MSA300_POSITION_X_UP        = 0,    ///< X axis up
+  MSA300_POSITION_X_DOWN      = 1,    ///< X axis down
+  MSA300_POSITION_Y_UP        = 2,    ///< Y axis up
+  MSA300_POSITION_Y_DOWN      = 3,    ///< Y axis down
+  MSA300_POSITION_Z_UP        = 4,    ///< Z axis up
+  MSA300_POSITION_Z_DOWN      = 5     ///< Z axis down
+} position_t;
+
+/** Calibration coefficients. Corrected = matrix * (measured - bias). */
+typedef struct
+{
+  int32_t sensorID;             ///< ID of the calibrated sensor
+  float   matrix[9];            ///< Row major correction matrix
+  float   bias[3];              ///< Bias in mg
+} calibration_t;
+
+/** Class for the six-position calibration procedure */
+class MSA300Calibration{
+ public:
+  MSA300Calibration(MSA300 &accel);
+
+  void        begin(void);
+  void        add(position_t position, const rawAcc_t *samples, uint16_t count);
+  void        collect(position_t position, uint16_t samples);
+  bool        complete(void);
+  bool        solve(calibration_t *calibration, float *residual = NULL);
+
+  static uint16_t serialize(const calibration_t *calibration, uint8_t *buffer, uint16_t size);
+  static bool deserialize(const uint8_t *buffer, uint16_t size, int32_t sensorID, calibration_t *calibration);
+
+ private:
+  MSA300     *_accel;
+  float       _mgPerLsb;
+  int64_t     _sum[6][3];
+  uint16_t    _count[6];
+};
+
+/** Class for applying calibration coefficients to raw samples in fixed point */
+class MSA300Correction{
+ public:
+  MSA300Correction(void);
+
+  bool        begin(const calibration_t *calibration, range_t range);
+  void        apply(const rawAcc_t *samples, rawAcc_t *corrected, uint16_t count);
+
+ private:
+  int16_t     _matrix[9];
+  int16_t     _bias[3];
+  bool        _enabled;
+};
+
+#endif // MSA300_CALIBRATION_H
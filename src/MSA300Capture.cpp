@@ -0,0 +1,182 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Capture.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Block capture of raw samples driven by the new data interrupt and DMA
+*/
+/**************************************************************************/
+#include "MSA300Capture.h"
+
+static_assert(sizeof(rawAcc_t) == 6, "rawAcc_t must match the 6 data registers");
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new capture
+    @param  accel
+            Sensor to capture from
+    @param  port
+            DMA port wired to the sensor's INT pin
+    @param  storage
+            Array of at least blockSamples * blocks samples
+    @param  blockSamples
+            Samples per block, the CPU is woken once per block
+    @param  blocks
+            Number of blocks in the storage (2 to 255)
+*/
+/**************************************************************************/
+MSA300Capture::MSA300Capture(MSA300 &accel, MSA300DmaPort &port, rawAcc_t *storage, uint16_t blockSamples, uint8_t blocks)
+{
+  _accel = &accel;
+  _port = &port;
+  _storage = storage;
+  _blockSamples = clamp<uint16_t>(blockSamples, 1, 65535 / clamp<uint8_t>(blocks, 2, 255));
+  _blocks = clamp<uint8_t>(blocks, 2, 255);
+  _tail = 0;
+  _completed = 0;
+  _released = 0;
+  _overruns = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Route the new data interrupt to a pin and start the DMA.
+            Switches the interrupt latch to non latched, since a latched
+            new data line would raise only one edge.
+    @param  interrupt
+            Pin the DMA port is triggered by, 1 or 2
+    @return True if capture was started
+*/
+/**************************************************************************/
+bool MSA300Capture::begin(uint8_t interrupt)
+{
+  _tail = 0;
+  _completed = 0;
+  _released = 0;
+  _overruns = 0;
+
+  _accel->setInterruptLatch(MSA300_INT_NON_LATCHED);
+  if (!_accel->enableInterrupt(MSA300_INT_SRC_NEW_DATA, interrupt)) {
+    return false;
+  }
+
+  if (!_port->start(MSA300_REG_ACC_X_LSB, (uint8_t *)_storage, sizeof(rawAcc_t),
+                    _blockSamples * _blocks, _blockSamples, onBlock, this)) {
+    _accel->disableInterrupt(MSA300_INT_SRC_NEW_DATA);
+    return false;
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stop the DMA and disable the new data interrupt. Completed
+            blocks stay available.
+*/
+/**************************************************************************/
+void MSA300Capture::end(void)
+{
+  _port->stop();
+  _accel->disableInterrupt(MSA300_INT_SRC_NEW_DATA);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Block handler for the DMA port. Runs in interrupt context.
+    @param  context
+            The capture
+*/
+/**************************************************************************/
+void MSA300Capture::onBlock(void *context)
+{
+  MSA300Capture *capture = (MSA300Capture *)context;
+
+  capture->_completed = capture->_completed + 1;
+
+  /* The DMA moves on into the oldest slot, which the consumer still holds */
+  if (capture->_completed - capture->_released >= capture->_blocks) {
+    capture->_overruns = capture->_overruns + 1;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of completed blocks. Blocks overwritten by the
+            DMA are dropped here and counted by overruns().
+    @return Number of blocks ready to be read
+*/
+/**************************************************************************/
+uint8_t MSA300Capture::available(void)
+{
+  uint32_t count = _completed - _released;
+
+  if (count > (uint32_t)(_blocks - 1)) {
+    uint32_t skip = count - (_blocks - 1);
+    _released = _released + skip;
+    _tail = (_tail + skip % _blocks) % _blocks;
+    count = _blocks - 1;
+  }
+
+  return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the oldest completed block. Call release() once it has
+            been used.
+    @return blockSamples() samples, or NULL if no block is ready
+*/
+/**************************************************************************/
+const rawAcc_t *MSA300Capture::block(void)
+{
+  if (available() == 0) {
+    return NULL;
+  }
+
+  return &_storage[(uint32_t)_tail * _blockSamples];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Hand the oldest block back to the DMA
+*/
+/**************************************************************************/
+void MSA300Capture::release(void)
+{
+  if (available() == 0) {
+    return;
+  }
+
+  _tail = (_tail + 1 == _blocks) ? 0 : _tail + 1;
+  _released = _released + 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the block size
+    @return Samples per block
+*/
+/**************************************************************************/
+uint16_t MSA300Capture::blockSamples(void)
+{
+  return _blockSamples;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of blocks the DMA overwrote before they were
+            released
+    @return Number of lost blocks
+*/
+/**************************************************************************/
+uint32_t MSA300Capture::overruns(void)
+{
+  return _overruns;
+}
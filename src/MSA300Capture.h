@@ -0,0 +1,103 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Capture.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Block capture of raw samples driven by the new data interrupt and DMA.
+
+    The MSA300 has no FIFO. Instead the new data interrupt line triggers a
+    6 byte burst read of the data registers straight into a circular
+    buffer, so no code runs per sample. The CPU is only woken once per
+    completed block. The data registers are little endian and laid out
+    like rawAcc_t, so the transferred bytes are used in place.
+
+    The hardware side is an MSA300DmaPort. A port for a specific MCU ties
+    the INT pin to a DMA request (e.g. EXTI or timer trigger to an
+    SPI/I2C read sequence in circular mode) and calls the block handler
+    from its transfer interrupt. MSA300SimDma in MSA300Sim.h is a host
+    side port for testing the capture logic.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_CAPTURE_H
+#define MSA300_CAPTURE_H
+
+#include "MSA300.h"
+
+/** DMA block handler, called from the transfer interrupt with the context given at start */
+typedef void (*dmaHandler_t)(void *context);
+
+/** Interface to a DMA engine that reads the sensor on every INT edge */
+class MSA300DmaPort{
+ public:
+  /**************************************************************************/
+  /*!
+      @brief  Start circular triggered transfers. Every trigger reads size
+              bytes starting at reg into the next slot of the buffer,
+              wrapping after the last slot.
+      @param  reg
+              First register of each burst
+      @param  buffer
+              Destination of size * transfers bytes
+      @param  size
+              Bytes per transfer
+      @param  transfers
+              Number of slots in the buffer
+      @param  blockTransfers
+              Call the handler after every blockTransfers transfers
+      @param  handler
+              Block handler
+      @param  context
+              Passed to the handler
+      @return False if the port cannot run the transfer
+  */
+  /**************************************************************************/
+  virtual bool start(uint8_t reg, uint8_t *buffer, uint16_t size, uint16_t transfers,
+                     uint16_t blockTransfers, dmaHandler_t handler, void *context) = 0;
+
+  /**************************************************************************/
+  /*!
+      @brief  Stop the transfers. No handler is called after this returns.
+  */
+  /**************************************************************************/
+  virtual void stop(void) = 0;
+};
+
+/** Class for DMA block capture. Storage is supplied by the caller and holds
+    blockSamples * blocks samples. One block is always being filled by the
+    DMA, so up to blocks - 1 completed blocks can be held by the consumer.
+    The bus belongs to the DMA port between begin() and end(). */
+class MSA300Capture{
+ public:
+  MSA300Capture(MSA300 &accel, MSA300DmaPort &port, rawAcc_t *storage, uint16_t blockSamples, uint8_t blocks);
+
+  bool        begin(uint8_t interrupt = 1);
+  void        end(void);
+
+  uint8_t     available(void);
+  const rawAcc_t *block(void);
+  void        release(void);
+  uint16_t    blockSamples(void);
+  uint32_t    overruns(void);
+
+  static void onBlock(void *context);
+
+ private:
+  MSA300     *_accel;
+  MSA300DmaPort *_port;
+  rawAcc_t   *_storage;
+  uint16_t    _blockSamples;
+  uint8_t     _blocks;
+  uint8_t     _tail;
+  volatile uint32_t _completed;
+  volatile uint32_t _released;
+  volatile uint32_t _overruns;
+};
+
+#endif // MSA300_CAPTURE_H
@@ -0,0 +1,351 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Codec.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Streaming delta/varint compression of raw MSA300 samples
+*/
+/**************************************************************************/
+#include "MSA300Codec.h"
+
+/** Decoder states */
+enum
+{
+  DECODE_SYNC,
+  DECODE_COUNT,
+  DECODE_SHIFT,
+  DECODE_KEYFRAME,
+  DECODE_DELTA,
+  DECODE_CHECKSUM
+};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new encoder
+    @param  frame
+            Frame buffer, should hold MSA300_CODEC_MAX_FRAME(frameSamples) bytes
+    @param  capacity
+            Size of the frame buffer, at least MSA300_CODEC_MAX_FRAME(1)
+    @param  frameSamples
+            Number of samples per frame (1 to 255). Shorter frames resync
+            faster, longer frames compress better. Reduced until a worst
+            case frame and its checksum fit the capacity.
+*/
+/**************************************************************************/
+MSA300Encoder::MSA300Encoder(uint8_t *frame, uint16_t capacity, uint8_t frameSamples)
+{
+  _frame = frame;
+  _capacity = capacity;
+  _frameSamples = clamp<uint8_t>(frameSamples, 1, 255);
+  while (_frameSamples > 1 && MSA300_CODEC_MAX_FRAME(_frameSamples) > capacity) {
+    _frameSamples--;
+  }
+  _shift = 16 - resolutionBits(MSA300_RES_14_BIT);
+  _count = 0;
+  _size = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start a new stream
+    @param  resolution
+            Resolution the samples were captured with. Bits below the
+            resolution are always zero and are not transmitted.
+*/
+/**************************************************************************/
+void MSA300Encoder::begin(res_t resolution)
+{
+  _shift = 16 - resolutionBits(resolution);
+  _count = 0;
+  _size = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Append one byte to the frame and update the checksum
+    @param  byte
+            Byte to be appended
+*/
+/**************************************************************************/
+inline void MSA300Encoder::put(uint8_t byte)
+{
+  if (_size < _capacity) {
+    _frame[_size++] = byte;
+  }
+
+  /* Fletcher-16, modulo 255 done with a conditional subtract */
+  uint16_t sum = _sum1 + byte;
+  _sum1 = (sum >= 255) ? sum - 255 : sum;
+  sum = _sum2 + _sum1;
+  _sum2 = (sum >= 255) ? sum - 255 : sum;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Append a zig-zag varint coded delta
+    @param  delta
+            Difference to the previous value
+*/
+/**************************************************************************/
+inline void MSA300Encoder::putDelta(int16_t delta)
+{
+  uint16_t zigzag = ((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+
+  while (zigzag >= 0x80) {
+    put((uint8_t)(zigzag | 0x80));
+    zigzag >>= 7;
+  }
+  put((uint8_t)zigzag);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Encode one sample
+    @param  sample
+            Raw sample
+    @return Size of the completed frame, or 0 if the frame is not full yet.
+            The frame stays valid until the next call to push().
+*/
+/**************************************************************************/
+uint16_t MSA300Encoder::push(const rawAcc_t *sample)
+{
+  int16_t value[3] = {
+    (int16_t)(sample->x >> _shift),
+    (int16_t)(sample->y >> _shift),
+    (int16_t)(sample->z >> _shift)
+  };
+
+  if (_count == 0) {
+    /* Keyframe starts every frame, so every frame decodes on its own */
+    _size = 0;
+    _sum1 = 0;
+    _sum2 = 0;
+    _frame[_size++] = MSA300_CODEC_SYNC;
+    put(_frameSamples);
+    put(_shift);
+    for (uint8_t i = 0; i < 3; i++) {
+      put((uint8_t)value[i]);
+      put((uint8_t)((uint16_t)value[i] >> 8));
+    }
+  } else {
+    for (uint8_t i = 0; i < 3; i++) {
+      putDelta(value[i] - _prev[i]);
+    }
+  }
+
+  _prev[0] = value[0];
+  _prev[1] = value[1];
+  _prev[2] = value[2];
+
+  if (++_count < _frameSamples) {
+    return 0;
+  }
+
+  return finish();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Close the current frame, even if it is not full
+    @return Size of the frame, or 0 if there was nothing to close
+*/
+/**************************************************************************/
+uint16_t MSA300Encoder::finish(void)
+{
+  if (_count == 0 || _size + MSA300_CODEC_CHECKSUM_SIZE > _capacity) {
+    _count = 0;
+    return 0;
+  }
+
+  /* Patch the real sample count of a partial frame and redo the checksum */
+  if (_count != _frameSamples) {
+    _frame[1] = _count;
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (uint16_t i = 1; i < _size; i++) {
+      sum1 = (sum1 + _frame[i]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+    }
+    _sum1 = sum1;
+    _sum2 = sum2;
+  }
+
+  _frame[_size++] = _sum1;
+  _frame[_size++] = _sum2;
+  _count = 0;
+
+  return _size;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the last completed frame
+    @return Frame bytes
+*/
+/**************************************************************************/
+const uint8_t *MSA300Encoder::frame(void)
+{
+  return _frame;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new decoder
+    @param  samples
+            Output buffer for one decoded frame
+    @param  maxSamples
+            Size of the output buffer. Frames with more samples are dropped.
+*/
+/**************************************************************************/
+MSA300Decoder::MSA300Decoder(rawAcc_t *samples, uint8_t maxSamples)
+{
+  _samples = samples;
+  _maxSamples = maxSamples;
+  _errors = 0;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop any partially decoded frame and wait for the next sync byte
+*/
+/**************************************************************************/
+void MSA300Decoder::reset(void)
+{
+  _state = DECODE_SYNC;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop the current frame and count it as an error
+*/
+/**************************************************************************/
+void MSA300Decoder::fail(void)
+{
+  _errors++;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Decode one byte of the stream
+    @param  byte
+            Next byte of the stream
+    @return Number of samples written to the output buffer when a frame
+            was completed and its checksum matched, otherwise 0
+*/
+/**************************************************************************/
+uint8_t MSA300Decoder::push(uint8_t byte)
+{
+  if (_state != DECODE_SYNC && _state != DECODE_CHECKSUM) {
+    _sum1 = (_sum1 + byte) % 255;
+    _sum2 = (_sum2 + _sum1) % 255;
+  }
+
+  switch(_state) {
+    case DECODE_SYNC:
+      if (byte == MSA300_CODEC_SYNC) {
+        _sum1 = 0;
+        _sum2 = 0;
+        _state = DECODE_COUNT;
+      }
+      break;
+
+    case DECODE_COUNT:
+      if (byte == 0 || byte > _maxSamples) {
+        fail();
+        break;
+      }
+      _count = byte;
+      _state = DECODE_SHIFT;
+      break;
+
+    case DECODE_SHIFT:
+      if (byte > 8) {
+        fail();
+        break;
+      }
+      _shift = byte;
+      _byte = 0;
+      _state = DECODE_KEYFRAME;
+      break;
+
+    case DECODE_KEYFRAME:
+      if ((_byte & 1) == 0) {
+        _value[_byte >> 1] = byte;
+      } else {
+        _value[_byte >> 1] |= (uint16_t)byte << 8;
+      }
+      if (++_byte < 6) {
+        break;
+      }
+      _samples[0].x = (int16_t)((uint16_t)_value[0] << _shift);
+      _samples[0].y = (int16_t)((uint16_t)_value[1] << _shift);
+      _samples[0].z = (int16_t)((uint16_t)_value[2] << _shift);
+      _index = 1;
+      _axis = 0;
+      _varint = 0;
+      _varintBits = 0;
+      _byte = 0;
+      _state = (_count > 1) ? DECODE_DELTA : DECODE_CHECKSUM;
+      break;
+
+    case DECODE_DELTA:
+      if (_varintBits > 14) {
+        fail();
+        break;
+      }
+      _varint |= (uint16_t)(byte & 0x7F) << _varintBits;
+      _varintBits += 7;
+      if (byte & 0x80) {
+        break;
+      }
+      _value[_axis] += (int16_t)((_varint >> 1) ^ (uint16_t)-(int16_t)(_varint & 1));
+      _varint = 0;
+      _varintBits = 0;
+      if (++_axis < 3) {
+        break;
+      }
+      _samples[_index].x = (int16_t)((uint16_t)_value[0] << _shift);
+      _samples[_index].y = (int16_t)((uint16_t)_value[1] << _shift);
+      _samples[_index].z = (int16_t)((uint16_t)_value[2] << _shift);
+      _axis = 0;
+      if (++_index >= _count) {
+        _state = DECODE_CHECKSUM;
+      }
+      break;
+
+    case DECODE_CHECKSUM:
+      if (_byte == 0) {
+        _check = byte;
+        _byte = 1;
+        break;
+      }
+      _check |= (uint16_t)byte << 8;
+      if (_check != (uint16_t)(_sum1 | (_sum2 << 8))) {
+        fail();
+        break;
+      }
+      reset();
+      return _count;
+  }
+
+  return 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of frames dropped because of corruption
+    @return Number of dropped frames
+*/
+/**************************************************************************/
+uint32_t MSA300Decoder::errors(void)
+{
+  return _errors;
+}
@@ -0,0 +1,94 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Codec.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Streaming delta/varint compression of raw MSA300 samples.
+
+    Samples are grouped into frames. Every frame starts with a sync byte,
+    the sample count and the resolution shift, followed by the first sample
+    as an absolute keyframe. The remaining samples are stored as per-axis
+    deltas to the previous sample, zig-zag mapped and varint coded. A
+    Fletcher-16 checksum closes the frame, so a decoder can resynchronize
+    at the next frame after any corruption.
+
+    Frame layout:
+    | 0xA5 | count | shift | x y z (int16 LE) | varint deltas ... | fletcher16 (LE) |
+*/
+/**************************************************************************/
+
+#ifndef MSA300_CODEC_H
+#define MSA300_CODEC_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    FRAME FORMAT
+    -----------------------------------------------------------------------*/
+    #define MSA300_CODEC_SYNC               (0xA5)    ///< Frame sync byte
+    #define MSA300_CODEC_HEADER_SIZE        (9)       ///< Sync, count, shift and keyframe
+    #define MSA300_CODEC_CHECKSUM_SIZE      (2)       ///< Fletcher-16 checksum
+    #define MSA300_CODEC_MAX_DELTA_SIZE     (9)       ///< Worst case bytes of one delta coded sample
+    /** Worst case size of a frame holding n samples */
+    #define MSA300_CODEC_MAX_FRAME(n)       (MSA300_CODEC_HEADER_SIZE + ((n) - 1) * MSA300_CODEC_MAX_DELTA_SIZE + MSA300_CODEC_CHECKSUM_SIZE)
+/*=========================================================================*/
+
+/** Class for encoding raw samples into frames. Work per sample is bounded, so it can run inside the acquisition loop. */
+class MSA300Encoder{
+ public:
+  MSA300Encoder(uint8_t *frame, uint16_t capacity, uint8_t frameSamples);
+
+  void        begin(res_t resolution);
+  uint16_t    push(const rawAcc_t *sample);
+  uint16_t    finish(void);
+  const uint8_t *frame(void);
+
+ private:
+  inline void put(uint8_t byte);
+  inline void putDelta(int16_t delta);
+
+  uint8_t *_frame;
+  uint16_t _capacity;
+  uint8_t  _frameSamples;
+  uint8_t  _shift;
+  uint8_t  _count;
+  uint16_t _size;
+  uint8_t  _sum1, _sum2;
+  int16_t  _prev[3];
+};
+
+/** Class for decoding a byte stream produced by MSA300Encoder */
+class MSA300Decoder{
+ public:
+  MSA300Decoder(rawAcc_t *samples, uint8_t maxSamples);
+
+  void        reset(void);
+  uint8_t     push(uint8_t byte);
+  uint32_t    errors(void);
+
+ private:
+  void        fail(void);
+
+  rawAcc_t *_samples;
+  uint8_t  _maxSamples;
+  uint8_t  _state;
+  uint8_t  _count;
+  uint8_t  _shift;
+  uint8_t  _index;
+  uint8_t  _axis;
+  uint8_t  _byte;
+  uint16_t _varint;
+  uint8_t  _varintBits;
+  uint8_t  _sum1, _sum2;
+  uint16_t _check;
+  int16_t  _value[3];
+  uint32_t _errors;
+};
+
+#endif // MSA300_CODEC_H
@@ -0,0 +1,353 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Config.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Persistent device configuration for MSA300
+*/
+/**************************************************************************/
+#include "MSA300Config.h"
+
+#if defined(MSA300_HAS_EEPROM)
+#include <EEPROM.h>
+#endif
+
+#if defined(__linux__)
+#include <stdio.h>
+#endif
+
+#define MSA300_CONFIG_HEADER_SIZE   (6)       // Magic, version, flags
+#define MSA300_CONFIG_CALIBRATION   (1 << 0)  // Calibration follows the image
+
+/**************************************************************************/
+/*!
+    @brief  CRC-16/CCITT, polynomial 0x1021, initial value 0xFFFF
+    @param  buffer
+            Data
+    @param  size
+            Number of bytes
+    @return CRC
+*/
+/**************************************************************************/
+static uint16_t crc16(const uint8_t *buffer, uint16_t size)
+{
+  uint16_t crc = 0xFFFF;
+
+  for (uint16_t i = 0; i < size; i++) {
+    crc ^= (uint16_t)buffer[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new configuration, empty until capture(),
+            deserialize() or load()
+    @param  accel
+            Sensor the configuration is captured from and restored to
+*/
+/**************************************************************************/
+MSA300Config::MSA300Config(MSA300 &accel)
+{
+  _accel = &accel;
+  _hasCalibration = false;
+  _valid = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Capture the current configuration of the sensor
+    @param  calibration
+            Calibration coefficients to store along, or NULL
+*/
+/**************************************************************************/
+void MSA300Config::capture(const calibration_t *calibration)
+{
+  _accel->readImage(_image);
+  _hasCalibration = (calibration != NULL);
+  if (calibration) {
+    _calibration = *calibration;
+  }
+  _valid = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start the sensor with the configuration, in place of begin()
+            and the setter sequence
+    @return False if there is no configuration or no sensor answers
+*/
+/**************************************************************************/
+bool MSA300Config::restore(void)
+{
+  return _valid && _accel->begin(_image);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the calibration coefficients of the configuration
+    @param  calibration
+            Coefficients to fill
+    @return False if the configuration has no calibration for this sensor
+*/
+/**************************************************************************/
+bool MSA300Config::getCalibration(calibration_t *calibration)
+{
+  if (!_valid || !_hasCalibration) {
+    return false;
+  }
+
+  *calibration = _calibration;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the register image of the configuration
+    @return MSA300_IMAGE_SIZE bytes, see MSA300::readImage()
+*/
+/**************************************************************************/
+const uint8_t *MSA300Config::image(void)
+{
+  return _image;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Serialize the configuration
+    @param  buffer
+            Destination
+    @param  size
+            Size of the destination, MSA300_CONFIG_MAX_SIZE is always
+            enough
+    @return Number of bytes written, 0 if there is no configuration or
+            the buffer is too small
+*/
+/**************************************************************************/
+uint16_t MSA300Config::serialize(uint8_t *buffer, uint16_t size)
+{
+  uint16_t length = MSA300_CONFIG_HEADER_SIZE + MSA300_IMAGE_SIZE +
+                    (_hasCalibration ? MSA300_CALIBRATION_BLOB_SIZE : 0) + 2;
+
+  if (!_valid || size < length) {
+    return 0;
+  }
+
+  memcpy(buffer, MSA300_CONFIG_MAGIC, 4);
+  buffer[4] = MSA300_CONFIG_VERSION;
+  buffer[5] = _hasCalibration ? MSA300_CONFIG_CALIBRATION : 0;
+  memcpy(&buffer[MSA300_CONFIG_HEADER_SIZE], _image, MSA300_IMAGE_SIZE);
+  if (_hasCalibration) {
+    MSA300Calibration::serialize(&_calibration, &buffer[MSA300_CONFIG_HEADER_SIZE + MSA300_IMAGE_SIZE],
+                                 MSA300_CALIBRATION_BLOB_SIZE);
+  }
+
+  uint16_t crc = crc16(buffer, length - 2);
+  buffer[length - 2] = (uint8_t)crc;
+  buffer[length - 1] = (uint8_t)(crc >> 8);
+
+  return length;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Restore a serialized configuration. Calibration coefficients of
+            another sensor are dropped, the register image is kept.
+    @param  buffer
+            Serialized configuration
+    @param  size
+            Number of valid bytes, may be more than the blob
+    @return False if the blob is damaged or of another format
+*/
+/**************************************************************************/
+bool MSA300Config::deserialize(const uint8_t *buffer, uint16_t size)
+{
+  if (size < MSA300_CONFIG_HEADER_SIZE + MSA300_IMAGE_SIZE + 2 ||
+      memcmp(buffer, MSA300_CONFIG_MAGIC, 4) != 0 || buffer[4] != MSA300_CONFIG_VERSION) {
+    return false;
+  }
+
+  bool calibration = buffer[5] & MSA300_CONFIG_CALIBRATION;
+  uint16_t length = MSA300_CONFIG_HEADER_SIZE + MSA300_IMAGE_SIZE +
+                    (calibration ? MSA300_CALIBRATION_BLOB_SIZE : 0) + 2;
+  if (size < length ||
+      crc16(buffer, length - 2) != (uint16_t)(buffer[length - 2] | (buffer[length - 1] << 8))) {
+    return false;
+  }
+
+  memcpy(_image, &buffer[MSA300_CONFIG_HEADER_SIZE], MSA300_IMAGE_SIZE);
+  _hasCalibration = calibration &&
+                    MSA300Calibration::deserialize(&buffer[MSA300_CONFIG_HEADER_SIZE + MSA300_IMAGE_SIZE],
+                                                   MSA300_CALIBRATION_BLOB_SIZE, _accel->getSensorID(),
+                                                   &_calibration);
+  _valid = true;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Serialize the configuration to storage
+    @param  storage
+            Storage backend
+    @return False if there is no configuration or the write failed
+*/
+/**************************************************************************/
+bool MSA300Config::save(MSA300Storage &storage)
+{
+  uint8_t buffer[MSA300_CONFIG_MAX_SIZE];
+  uint16_t size = serialize(buffer, sizeof(buffer));
+
+  return size && storage.write(buffer, size);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Restore the configuration from storage
+    @param  storage
+            Storage backend
+    @return False if the storage holds no valid configuration
+*/
+/**************************************************************************/
+bool MSA300Config::load(MSA300Storage &storage)
+{
+  uint8_t buffer[MSA300_CONFIG_MAX_SIZE];
+  uint16_t size = storage.read(buffer, sizeof(buffer));
+
+  return deserialize(buffer, size);
+}
+
+#if defined(MSA300_HAS_EEPROM)
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new EEPROM backend
+    @param  address
+            First EEPROM address of the blob, MSA300_CONFIG_MAX_SIZE bytes
+            are used
+*/
+/**************************************************************************/
+MSA300EepromStorage::MSA300EepromStorage(uint16_t address)
+{
+  _address = address;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write the blob. Unchanged bytes are not rewritten, which saves
+            EEPROM wear.
+    @param  buffer
+            Blob
+    @param  size
+            Size of the blob
+    @return True
+*/
+/**************************************************************************/
+bool MSA300EepromStorage::write(const uint8_t *buffer, uint16_t size)
+{
+#if defined(ESP8266) || defined(ESP32)
+  EEPROM.begin(_address + MSA300_CONFIG_MAX_SIZE);
+#endif
+  for (uint16_t i = 0; i < size; i++) {
+    if (EEPROM.read(_address + i) != buffer[i]) {
+      EEPROM.write(_address + i, buffer[i]);
+    }
+  }
+#if defined(ESP8266) || defined(ESP32)
+  return EEPROM.commit();
+#else
+  return true;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read the blob
+    @param  buffer
+            Destination
+    @param  size
+            Size of the destination
+    @return Number of bytes read
+*/
+/**************************************************************************/
+uint16_t MSA300EepromStorage::read(uint8_t *buffer, uint16_t size)
+{
+#if defined(ESP8266) || defined(ESP32)
+  EEPROM.begin(_address + MSA300_CONFIG_MAX_SIZE);
+#endif
+  for (uint16_t i = 0; i < size; i++) {
+    buffer[i] = EEPROM.read(_address + i);
+  }
+
+  return size;
+}
+#endif
+
+#if defined(__linux__)
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new file backend
+    @param  path
+            Path of the file, must stay valid
+*/
+/**************************************************************************/
+MSA300FileStorage::MSA300FileStorage(const char *path)
+{
+  _path = path;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replace the file with the blob
+    @param  buffer
+            Blob
+    @param  size
+            Size of the blob
+    @return False if the file could not be written
+*/
+/**************************************************************************/
+bool MSA300FileStorage::write(const uint8_t *buffer, uint16_t size)
+{
+  FILE *file = fopen(_path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  bool written = fwrite(buffer, 1, size, file) == size;
+
+  return (fclose(file) == 0) && written;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read the blob
+    @param  buffer
+            Destination
+    @param  size
+            Size of the destination
+    @return Number of bytes read, 0 if the file does not exist
+*/
+/**************************************************************************/
+uint16_t MSA300FileStorage::read(uint8_t *buffer, uint16_t size)
+{
+  FILE *file = fopen(_path, "rb");
+  if (!file) {
+    return 0;
+  }
+
+  uint16_t count = (uint16_t)fread(buffer, 1, size, file);
+  fclose(file);
+
+  return count;
+}
+#endif
@@ -0,0 +1,108 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Config.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Persistent device configuration.
+
+    A configuration is the register image of all writable configuration
+    registers, optionally followed by the calibration coefficients of the
+    sensor, protected by a CRC-16. It is restored with one burst write per
+    contiguous register run instead of the begin() and setter sequence.
+    The register image can go to any sensor of a fleet, the calibration
+    is only restored on the sensor it belongs to.
+
+    The blob is the 4 byte MSA300_CONFIG_MAGIC, a version byte, a flags
+    byte, the MSA300_IMAGE_SIZE byte register image, the calibration
+    blob of MSA300Calibration if flag bit 0 is set, and the CRC-16/CCITT
+    of everything before it. All fields are little endian.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_CONFIG_H
+#define MSA300_CONFIG_H
+
+#include "MSA300.h"
+#include "MSA300Calibration.h"
+
+/*=========================================================================
+    CONFIGURATION
+    -----------------------------------------------------------------------*/
+    #define MSA300_CONFIG_MAGIC             "MSAI"    ///< Blob magic
+    #define MSA300_CONFIG_VERSION           (1)       ///< Blob format version
+    #define MSA300_CONFIG_MAX_SIZE          (6 + MSA300_IMAGE_SIZE + MSA300_CALIBRATION_BLOB_SIZE + 2) ///< Largest blob
+/*=========================================================================*/
+
+/** Abstract blob storage */
+class MSA300Storage{
+ public:
+  /** Replace the stored blob */
+  virtual bool write(const uint8_t *buffer, uint16_t size) = 0;
+  /** Read up to size bytes of the stored blob, returns the number of bytes read */
+  virtual uint16_t read(uint8_t *buffer, uint16_t size) = 0;
+};
+
+#if defined(__has_include)
+#if __has_include(<EEPROM.h>)
+#define MSA300_HAS_EEPROM
+#endif
+#endif
+
+#if defined(MSA300_HAS_EEPROM)
+/** Class for storing the blob in the Arduino EEPROM (or its flash emulation) */
+class MSA300EepromStorage : public MSA300Storage{
+ public:
+  MSA300EepromStorage(uint16_t address = 0);
+
+  bool        write(const uint8_t *buffer, uint16_t size);
+  uint16_t    read(uint8_t *buffer, uint16_t size);
+
+ private:
+  uint16_t    _address;
+};
+#endif
+
+#if defined(__linux__)
+/** Class for storing the blob in a file on Linux */
+class MSA300FileStorage : public MSA300Storage{
+ public:
+  MSA300FileStorage(const char *path);
+
+  bool        write(const uint8_t *buffer, uint16_t size);
+  uint16_t    read(uint8_t *buffer, uint16_t size);
+
+ private:
+  const char *_path;
+};
+#endif
+
+/** Class for capturing, persisting and restoring the device configuration */
+class MSA300Config{
+ public:
+  MSA300Config(MSA300 &accel);
+
+  void        capture(const calibration_t *calibration = NULL);
+  bool        restore(void);
+  bool        getCalibration(calibration_t *calibration);
+  const uint8_t *image(void);
+
+  uint16_t    serialize(uint8_t *buffer, uint16_t size);
+  bool        deserialize(const uint8_t *buffer, uint16_t size);
+  bool        save(MSA300Storage &storage);
+  bool        load(MSA300Storage &storage);
+
+ private:
+  MSA300     *_accel;
+  uint8_t     _image[MSA300_IMAGE_SIZE];
+  calibration_t _calibration;
+  bool        _hasCalibration;
+  bool        _valid;
+};
+
+#endif // MSA300_CONFIG_H
@@ -0,0 +1,112 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Dispatch.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Per-event interrupt handler dispatch for MSA300
+*/
+/**************************************************************************/
+#include "MSA300Dispatch.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new dispatcher without handlers
+*/
+/**************************************************************************/
+MSA300Dispatcher::MSA300Dispatcher(void)
+{
+  memset(_handlers, 0, sizeof(_handlers));
+  memset(_contexts, 0, sizeof(_contexts));
+  _mask = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Register the handler of an event, replacing any previous one
+    @param  event
+            Event to handle
+    @param  handler
+            Function called when the event is raised
+    @param  context
+            Pointer passed to the handler
+*/
+/**************************************************************************/
+void MSA300Dispatcher::on(event_t event, eventHandler_t handler, void *context)
+{
+  _handlers[event] = handler;
+  _contexts[event] = context;
+
+  if (handler) {
+    _mask |= (1 << event);
+  } else {
+    _mask &= ~(1 << event);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Remove the handler of an event
+    @param  event
+            Event to stop handling
+*/
+/**************************************************************************/
+void MSA300Dispatcher::off(event_t event)
+{
+  on(event, NULL, NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Call the handlers of all raised events. Only events that have a
+            handler are visited.
+    @param  interrupts
+            Interrupt status, e.g. from checkInterrupts() or readFrame()
+    @return Number of handlers called
+*/
+/**************************************************************************/
+uint8_t MSA300Dispatcher::dispatch(const interrupt_t &interrupts)
+{
+  /* Event values are the MOTION_INT bit positions, new data takes bit 7 */
+  uint8_t pending = ((interrupts.motion & 0x75) | ((interrupts.data & 1) << 7)) & _mask;
+  uint8_t called = 0;
+
+  while (pending) {
+    uint8_t event = __builtin_ctz(pending);
+    pending &= pending - 1;
+    _handlers[event](interrupts, _contexts[event]);
+    called++;
+  }
+
+  return called;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read the interrupt status once and dispatch it. Meant to be
+            called after the INT line fired, or polled with latched
+            interrupts.
+    @param  accel
+            Sensor to service
+    @param  reset
+            Reset latched interrupts if any event was raised
+    @return Number of handlers called
+*/
+/**************************************************************************/
+uint8_t MSA300Dispatcher::service(MSA300 &accel, bool reset)
+{
+  interrupt_t interrupts = accel.checkInterrupts();
+
+  uint8_t called = dispatch(interrupts);
+
+  if (reset && interrupts.any()) {
+    accel.resetInterrupt();
+  }
+
+  return called;
+}
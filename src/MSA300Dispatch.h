@@ -0,0 +1,51 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Dispatch.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Per-event interrupt handler dispatch for MSA300
+*/
+/**************************************************************************/
+
+#ifndef MSA300_DISPATCH_H
+#define MSA300_DISPATCH_H
+
+#include "MSA300.h"
+
+/** Interrupt events. Values are bit positions in the dispatcher's event mask. */
+typedef enum
+{
+  MSA300_EVENT_FREEFALL       = 0,    ///< Freefall interrupt
+  MSA300_EVENT_ACTIVE         = 2,    ///< Active interrupt
+  MSA300_EVENT_DOUBLE_TAP     = 4,    ///< Double tap interrupt
+  MSA300_EVENT_SINGLE_TAP     = 5,    ///< Single tap interrupt
+  MSA300_EVENT_ORIENTATION    = 6,    ///< Orientation interrupt
+  MSA300_EVENT_NEW_DATA       = 7     ///< New data interrupt
+} event_t;
+
+/** Event handler. Receives the decoded status and the context given at registration. */
+typedef void (*eventHandler_t)(const interrupt_t &interrupts, void *context);
+
+/** Class for dispatching interrupts to per-event handlers. Storage is static, nothing is allocated. */
+class MSA300Dispatcher{
+ public:
+  MSA300Dispatcher(void);
+
+  void        on(event_t event, eventHandler_t handler, void *context = NULL);
+  void        off(event_t event);
+  uint8_t     dispatch(const interrupt_t &interrupts);
+  uint8_t     service(MSA300 &accel, bool reset = true);
+
+ private:
+  eventHandler_t _handlers[8];
+  void       *_contexts[8];
+  uint8_t     _mask;
+};
+
+#endif // MSA300_DISPATCH_H
@@ -0,0 +1,267 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Drop.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Drop event recorder
+*/
+/**************************************************************************/
+#include "MSA300Drop.h"
+
+/** Recorder states */
+enum
+{
+  DROP_IDLE,
+  DROP_ARMED,
+  DROP_FALLING,
+  DROP_IMPACT,
+  DROP_DONE
+};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new drop recorder
+    @param  accel
+            Sensor with the freefall interrupt configured
+    @param  window
+            Buffer for the samples around the event. Should hold the
+            pre-trigger samples plus the fall, impact and rest period at
+            1000 Hz.
+*/
+/**************************************************************************/
+MSA300DropRecorder::MSA300DropRecorder(MSA300 &accel, MSA300Buffer &window)
+{
+  _accel = &accel;
+  _window = &window;
+  _state = DROP_IDLE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read the freefall configuration, enable the freefall interrupt
+            and arm the recorder. Configure range, data rate and the
+            freefall threshold and duration before calling this.
+    @param  interrupt
+            Pin for the freefall interrupt, 1 or 2
+    @param  impactMg
+            Peak magnitude that flags a hard impact, in mg
+    @param  restMg
+            Allowed deviation from 1 g at rest, in mg
+    @param  restMs
+            Time the sensor has to stay within restMg to be at rest
+    @param  preSamples
+            Number of samples kept from before the trigger
+    @return True if the interrupt could be routed
+*/
+/**************************************************************************/
+bool MSA300DropRecorder::begin(uint8_t interrupt, uint16_t impactMg, uint16_t restMg, uint16_t restMs, uint8_t preSamples)
+{
+  uint8_t freefall[2];
+
+  _scale = (float)(2000 << _accel->getRange()) / 32768.0f;
+  _dataRate = _accel->getDataRate();
+
+  /* Freefall duration and threshold, in the units of their setters */
+  _accel->readRegisters(MSA300_REG_FREEFALL_DUR, freefall, 2);
+  _fallDuration = (freefall[0] + 1) * 2;
+
+  float freefallRaw = freefall[1] * 7.81f / _scale;
+  float impactRaw = impactMg / _scale;
+  float restLowRaw = (1000 - clamp<uint16_t>(restMg, 0, 1000)) / _scale;
+  float restHighRaw = (1000 + restMg) / _scale;
+
+  _freefall2 = (uint32_t)(freefallRaw * freefallRaw);
+  _impact2 = (uint32_t)clamp<float>(impactRaw * impactRaw, 0, 4294967295.0f);
+  _restLow2 = (uint32_t)(restLowRaw * restLowRaw);
+  _restHigh2 = (uint32_t)clamp<float>(restHighRaw * restHighRaw, 0, 4294967295.0f);
+  _restMs = restMs;
+  _preSamples = preSamples;
+
+  arm();
+
+  return _accel->enableInterrupt(MSA300_INT_SRC_FREEFALL, interrupt);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop the previous event and its window and wait for the next
+            trigger
+*/
+/**************************************************************************/
+void MSA300DropRecorder::arm(void)
+{
+  _window->clear();
+  _state = DROP_ARMED;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start recording. Call when the freefall interrupt fires. Only
+            switches the data rate, a single register write, so the impact
+            is sampled at full rate.
+    @param  now
+            Current time in microseconds, e.g. micros()
+*/
+/**************************************************************************/
+void MSA300DropRecorder::trigger(uint32_t now)
+{
+  if (_state != DROP_ARMED) {
+    return;
+  }
+
+  _accel->setDataRate(MSA300_DATARATE_1000_HZ);
+
+  /* Count the low g samples leading up to the trigger. Without any in the
+     history, the fall has lasted the configured duration. */
+  uint16_t falling = 0;
+  rawAcc_t sample;
+  while (_window->peek(_window->available() - 1 - falling, &sample) && magnitude2(&sample) <= _freefall2) {
+    falling++;
+  }
+
+  if (falling > 0) {
+    _event.start = now - (uint32_t)(falling * 1000000.0f / dataRateToHz(_dataRate));
+  } else {
+    _event.start = now - (uint32_t)_fallDuration * 1000;
+  }
+  _event.fallTime = 0;
+  _event.peak = 0;
+  _event.restTime = 0;
+  _event.flags = 0;
+
+  uint16_t history = _window->available();
+  if (history > _preSamples) {
+    _window->consume(history - _preSamples);
+  }
+  _event.preSamples = _window->available();
+
+  _peak2 = 0;
+  _state = DROP_FALLING;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the squared magnitude of a sample
+    @param  sample
+            Raw sample
+    @return Squared magnitude in raw units
+*/
+/**************************************************************************/
+uint32_t MSA300DropRecorder::magnitude2(const rawAcc_t *sample)
+{
+  return (uint32_t)((int32_t)sample->x * sample->x) +
+         (uint32_t)((int32_t)sample->y * sample->y) +
+         (uint32_t)((int32_t)sample->z * sample->z);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Close the event and restore the data rate
+    @param  flags
+            Event flags
+*/
+/**************************************************************************/
+void MSA300DropRecorder::finish(uint8_t flags)
+{
+  _event.peak = (uint16_t)clamp<float>(sqrtf((float)_peak2) * _scale, 0, 65535);
+  _event.flags |= flags;
+  _accel->setDataRate(_dataRate);
+  _state = DROP_DONE;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Process one sample. Call for every sample read from the sensor,
+            also while armed so the pre-trigger history is kept.
+    @param  sample
+            Raw sample
+    @param  now
+            Time of the sample in microseconds
+    @return True when an event was completed by this sample
+*/
+/**************************************************************************/
+bool MSA300DropRecorder::update(const rawAcc_t *sample, uint32_t now)
+{
+  if (_state == DROP_ARMED) {
+    if (_window->full()) {
+      _window->consume(1);
+    }
+    _window->push(sample);
+    return false;
+  }
+
+  if (_state != DROP_FALLING && _state != DROP_IMPACT) {
+    return false;
+  }
+
+  if (!_window->push(sample)) {
+    if (_state == DROP_FALLING) {
+      _event.fallTime = (now - _event.start) / 1000;
+    }
+    finish(MSA300_DROP_TRUNCATED);
+    return true;
+  }
+
+  uint32_t magnitude = magnitude2(sample);
+
+  if (_state == DROP_FALLING) {
+    if (magnitude <= _freefall2) {
+      return false;
+    }
+    _event.fallTime = (now - _event.start) / 1000;
+    _impactAt = now;
+    _stillSince = now;
+    _state = DROP_IMPACT;
+  }
+
+  if (magnitude > _peak2) {
+    _peak2 = magnitude;
+  }
+
+  if (magnitude >= _impact2) {
+    _event.flags |= MSA300_DROP_IMPACT;
+  }
+
+  if (magnitude < _restLow2 || magnitude > _restHigh2) {
+    _stillSince = now;
+  } else if (now - _stillSince >= (uint32_t)_restMs * 1000) {
+    _event.restTime = (_stillSince - _impactAt) / 1000;
+    finish(MSA300_DROP_AT_REST);
+    return true;
+  }
+
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if a drop is being recorded
+    @return True between trigger() and the end of the event
+*/
+/**************************************************************************/
+bool MSA300DropRecorder::busy(void)
+{
+  return _state == DROP_FALLING || _state == DROP_IMPACT;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the last completed event. Its samples are in the window
+            buffer until arm() is called.
+    @return Event record, or NULL if no event was completed
+*/
+/**************************************************************************/
+const dropEvent_t *MSA300DropRecorder::event(void)
+{
+  if (_state != DROP_DONE) {
+    return NULL;
+  }
+
+  return &_event;
+}
@@ -0,0 +1,82 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Drop.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Drop event recorder.
+
+    The chip's freefall interrupt only tells that the sensor is falling.
+    The recorder arms on that interrupt, switches the sensor to its
+    maximum data rate with a single register write, and follows the fall
+    in software: end of freefall, impact peak and the time until the
+    sensor is at rest. The samples around the event are kept in an
+    MSA300Buffer, which holds the pre-trigger history while armed.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_DROP_H
+#define MSA300_DROP_H
+
+#include "MSA300.h"
+#include "MSA300Buffer.h"
+
+/** Drop event flags */
+typedef enum
+{
+  MSA300_DROP_AT_REST         = 0x01,   ///< Sensor came to rest after the impact
+  MSA300_DROP_TRUNCATED       = 0x02,   ///< Window filled up before the sensor came to rest
+  MSA300_DROP_IMPACT          = 0x04    ///< Peak reached the impact threshold
+} dropFlag_t;
+
+/** Drop event record (12 bytes) */
+typedef struct
+{
+  uint32_t start;               ///< Start of the freefall in microseconds
+  uint16_t fallTime;            ///< Freefall duration in ms
+  uint16_t peak;                ///< Impact peak magnitude in mg
+  uint16_t restTime;            ///< Time from impact to rest in ms
+  uint8_t  preSamples;          ///< Window samples recorded before the trigger
+  uint8_t  flags;               ///< dropFlag_t values combined with |
+} dropEvent_t;
+
+/** Class for recording drop events */
+class MSA300DropRecorder{
+ public:
+  MSA300DropRecorder(MSA300 &accel, MSA300Buffer &window);
+
+  bool        begin(uint8_t interrupt = 1, uint16_t impactMg = 2000, uint16_t restMg = 100, uint16_t restMs = 250, uint8_t preSamples = 32);
+  void        arm(void);
+  void        trigger(uint32_t now);
+  bool        update(const rawAcc_t *sample, uint32_t now);
+  bool        busy(void);
+  const dropEvent_t *event(void);
+
+ private:
+  uint32_t    magnitude2(const rawAcc_t *sample);
+  void        finish(uint8_t flags);
+
+  MSA300     *_accel;
+  MSA300Buffer *_window;
+  dropEvent_t _event;
+  uint8_t     _state;
+  dataRate_t  _dataRate;
+  uint16_t    _fallDuration;
+  uint32_t    _freefall2;
+  uint32_t    _impact2;
+  uint32_t    _restLow2;
+  uint32_t    _restHigh2;
+  uint32_t    _peak2;
+  float       _scale;
+  uint16_t    _restMs;
+  uint8_t     _preSamples;
+  uint32_t    _impactAt;
+  uint32_t    _stillSince;
+};
+
+#endif // MSA300_DROP_H
@@ -0,0 +1,257 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Duty.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Duty cycled burst sampling for MSA300
+*/
+/**************************************************************************/
+#include "MSA300Duty.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new duty cycle scheduler
+    @param  accel
+            Sensor, configured for the burst (range, data rate, ...)
+    @param  buffer
+            Buffer the burst samples are pushed to
+*/
+/**************************************************************************/
+MSA300DutyCycle::MSA300DutyCycle(MSA300 &accel, MSA300Buffer &buffer)
+{
+  _accel = &accel;
+  _buffer = &buffer;
+  _running = false;
+  _awake = false;
+  _bursts = 0;
+  _dropped = 0;
+  _awakeTotal = 0;
+  setCurrents(MSA300_CURRENT_NORMAL_UA, MSA300_CURRENT_SUSPEND_UA);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Suspend the chip and schedule the first burst. Uses the data
+            rate the chip is configured with.
+    @param  periodMs
+            Time between the starts of two bursts
+    @param  burstSamples
+            Samples per burst
+    @param  nowUs
+            Current time in microseconds, e.g. micros()
+    @return False if a burst does not fit in the period
+*/
+/**************************************************************************/
+bool MSA300DutyCycle::begin(uint32_t periodMs, uint16_t burstSamples, uint32_t nowUs)
+{
+  _samplePeriod = (uint32_t)(1000000.0f / dataRateToHz(_accel->getDataRate()));
+  _latency = _accel->getWakeLatency();
+  _period = periodMs * 1000;
+  _burst = burstSamples;
+
+  if (burstSamples == 0 || _latency + (uint32_t)burstSamples * _samplePeriod >= _period) {
+    _running = false;
+    return false;
+  }
+
+  _accel->suspend();
+  _awake = false;
+  _running = true;
+  _bursts = 0;
+  _dropped = 0;
+  _awakeTotal = 0;
+  /* First burst as soon as the chip can deliver it */
+  _boundary = nowUs + _latency;
+  _wakeAt = nowUs;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stop scheduling. The chip is left in suspend mode.
+*/
+/**************************************************************************/
+void MSA300DutyCycle::end(void)
+{
+  if (_awake) {
+    _accel->suspend();
+    _awake = false;
+  }
+  _running = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the supply currents used by averageCurrent()
+    @param  normalUa
+            Current while awake in microamperes
+    @param  suspendUa
+            Current in suspend mode in microamperes
+*/
+/**************************************************************************/
+void MSA300DutyCycle::setCurrents(float normalUa, float suspendUa)
+{
+  _normalUa = normalUa;
+  _suspendUa = suspendUa;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Run the schedule. Call at least once per sample period while
+            awake(), and before nextEvent() has passed while asleep.
+    @param  nowUs
+            Current time in microseconds, e.g. micros()
+    @return True if a burst was completed, its samples are in the buffer
+*/
+/**************************************************************************/
+bool MSA300DutyCycle::update(uint32_t nowUs)
+{
+  if (!_running) {
+    return false;
+  }
+
+  if (!_awake) {
+    if ((int32_t)(nowUs - _wakeAt) < 0) {
+      return false;
+    }
+
+    /* First sample on the boundary, or once settled if woken late */
+    uint32_t ready = nowUs + _accel->resume();
+    _sampleAt = ((int32_t)(ready - _boundary) > 0) ? ready : _boundary;
+    _awakeSince = nowUs;
+    _awake = true;
+    _count = 0;
+    return false;
+  }
+
+  if ((int32_t)(nowUs - _sampleAt) < 0) {
+    return false;
+  }
+
+  rawAcc_t sample;
+  _accel->getRawAcceleration(&sample);
+  if (!_buffer->push(&sample)) {
+    _dropped++;
+  }
+
+  /* A late call must not read the same sample twice */
+  _sampleAt += _samplePeriod;
+  if ((int32_t)(nowUs - _sampleAt) >= 0) {
+    _sampleAt = nowUs + _samplePeriod;
+  }
+
+  if (++_count < _burst) {
+    return false;
+  }
+
+  finishBurst(nowUs);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Suspend the chip and plan the next wake up
+    @param  nowUs
+            Current time in microseconds
+*/
+/**************************************************************************/
+void MSA300DutyCycle::finishBurst(uint32_t nowUs)
+{
+  _accel->suspend();
+  _awake = false;
+  _awakeTotal += nowUs - _awakeSince;
+  _bursts++;
+
+  /* Skip periods that can no longer be woken up for in time */
+  _boundary += _period;
+  uint32_t ready = nowUs + _latency;
+  if ((int32_t)(ready - _boundary) >= 0) {
+    _boundary += ((ready - _boundary) / _period + 1) * _period;
+  }
+  _wakeAt = _boundary - _latency;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if the chip is awake for a burst
+    @return True between wake up and the end of the burst
+*/
+/**************************************************************************/
+bool MSA300DutyCycle::awake(void)
+{
+  return _awake;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the time until update() has something to do, so the MCU
+            can sleep until then
+    @param  nowUs
+            Current time in microseconds
+    @return Microseconds, 0 if update() is due
+*/
+/**************************************************************************/
+uint32_t MSA300DutyCycle::nextEvent(uint32_t nowUs)
+{
+  if (!_running) {
+    return UINT32_MAX;
+  }
+
+  int32_t wait = (int32_t)((_awake ? _sampleAt : _wakeAt) - nowUs);
+
+  return (wait > 0) ? (uint32_t)wait : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of completed bursts
+    @return Bursts since begin()
+*/
+/**************************************************************************/
+uint32_t MSA300DutyCycle::bursts(void)
+{
+  return _bursts;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of samples lost to a full buffer
+    @return Samples since begin()
+*/
+/**************************************************************************/
+uint32_t MSA300DutyCycle::dropped(void)
+{
+  return _dropped;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Estimate the average supply current of the sensor. Uses the
+            measured awake time once a burst has completed, the planned
+            one before.
+    @return Average current in microamperes
+*/
+/**************************************************************************/
+float MSA300DutyCycle::averageCurrent(void)
+{
+  if (!_running && _bursts == 0) {
+    return 0;
+  }
+
+  float duty;
+  if (_bursts > 0) {
+    duty = (float)_awakeTotal / ((float)_bursts * _period);
+  } else {
+    duty = (float)(_latency + (uint32_t)_burst * _samplePeriod) / _period;
+  }
+
+  return _suspendUa + (_normalUa - _suspendUa) * duty;
+}
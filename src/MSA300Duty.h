@@ -0,0 +1,68 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Duty.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Duty cycled burst sampling.
+
+    The chip sleeps in suspend mode and wakes once per period for a burst
+    of samples, then goes back to suspend. The wake up is moved ahead by
+    the wake latency of the driver, so the first sample of a burst is
+    settled and lands on the period boundary. Samples go to an
+    MSA300Buffer. The scheduler does not block, call update() from the
+    main loop and sleep the MCU for nextEvent() in between.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_DUTY_H
+#define MSA300_DUTY_H
+
+#include "MSA300.h"
+#include "MSA300Buffer.h"
+
+/** Class for duty cycled burst sampling */
+class MSA300DutyCycle{
+ public:
+  MSA300DutyCycle(MSA300 &accel, MSA300Buffer &buffer);
+
+  bool        begin(uint32_t periodMs, uint16_t burstSamples, uint32_t nowUs);
+  void        end(void);
+  void        setCurrents(float normalUa, float suspendUa);
+
+  bool        update(uint32_t nowUs);
+  bool        awake(void);
+  uint32_t    nextEvent(uint32_t nowUs);
+  uint32_t    bursts(void);
+  uint32_t    dropped(void);
+  float       averageCurrent(void);
+
+ private:
+  void        finishBurst(uint32_t nowUs);
+
+  MSA300     *_accel;
+  MSA300Buffer *_buffer;
+  uint32_t    _period;
+  uint32_t    _samplePeriod;
+  uint32_t    _latency;
+  uint16_t    _burst;
+  uint16_t    _count;
+  bool        _running;
+  bool        _awake;
+  uint32_t    _boundary;
+  uint32_t    _wakeAt;
+  uint32_t    _sampleAt;
+  uint32_t    _awakeSince;
+  uint64_t    _awakeTotal;
+  uint32_t    _bursts;
+  uint32_t    _dropped;
+  float       _normalUa;
+  float       _suspendUa;
+};
+
+#endif // MSA300_DUTY_H
@@ -0,0 +1,277 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Goertzel.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Goertzel filter bank for raw MSA300 samples
+*/
+/**************************************************************************/
+#include "MSA300Goertzel.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* Coefficients are 2cos(w) in Q29, fine enough for tones one bin above DC */
+#define MSA300_GOERTZEL_Q           (29)
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new Goertzel filter bank
+*/
+/**************************************************************************/
+MSA300Goertzel::MSA300Goertzel(void)
+{
+  _window = 0;
+  _count = 0;
+  _sampleRate = 0;
+  _shift = 0;
+  _mgPerLsb = 0;
+  _ready = false;
+  _centered = false;
+  _tones = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Configure the window. Tones added before are kept and retuned.
+    @param  windowSamples
+            Samples per window, 8 to MSA300_GOERTZEL_MAX_WINDOW. Need not
+            be a power of two.
+    @param  dataRate
+            Output data rate the samples are measured at
+    @param  range
+            Range the samples are measured in
+    @param  resolution
+            Resolution the samples are measured in
+    @return False if the window is out of range
+*/
+/**************************************************************************/
+bool MSA300Goertzel::begin(uint16_t windowSamples, dataRate_t dataRate, range_t range, res_t resolution)
+{
+  if (windowSamples < 8 || windowSamples > MSA300_GOERTZEL_MAX_WINDOW) {
+    _window = 0;
+    return false;
+  }
+
+  _window = windowSamples;
+  _sampleRate = dataRateToHz(dataRate);
+  _shift = 16 - resolutionBits(resolution);
+  _mgPerLsb = (float)(2000 << range) / (float)(1 << (resolutionBits(resolution) - 1));
+
+  uint8_t tones = _tones;
+  _tones = 0;
+  for (uint8_t i = 0; i < tones; i++) {
+    addTone(_frequency[i], (axis_t)_axis[i]);
+  }
+  _count = 0;
+  _ready = false;
+  _centered = false;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add a tone to the bank
+    @param  frequency
+            Tone frequency in Hz, from one bin (data rate / window) up to
+            half the data rate
+    @param  axis
+            Axis the tone is tracked on
+    @return Index of the tone, or -1 if the bank is full or the
+            frequency is out of range
+*/
+/**************************************************************************/
+int8_t MSA300Goertzel::addTone(float frequency, axis_t axis)
+{
+  if (_window == 0 || _tones >= MSA300_GOERTZEL_MAX_TONES ||
+      frequency < _sampleRate / _window || frequency > _sampleRate / 2) {
+    return -1;
+  }
+
+  uint8_t tone = _tones++;
+  _frequency[tone] = frequency;
+  _axis[tone] = axis;
+  _coeff[tone] = (int32_t)lround(2.0 * cos(2.0 * M_PI * frequency / _sampleRate) * (1L << MSA300_GOERTZEL_Q));
+  _s1[tone] = 0;
+  _s2[tone] = 0;
+  _amplitude[tone] = 0;
+
+  return tone;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Remove all tones
+*/
+/**************************************************************************/
+void MSA300Goertzel::clearTones(void)
+{
+  _tones = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of tones in the bank
+    @return Number of tones
+*/
+/**************************************************************************/
+uint8_t MSA300Goertzel::getTones(void)
+{
+  return _tones;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add one sample
+    @param  sample
+            Raw sample
+    @return True if the sample completed a window
+*/
+/**************************************************************************/
+bool MSA300Goertzel::update(const rawAcc_t *sample)
+{
+  update(sample, 1);
+
+  return _ready;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add a batch of samples. Stops after the sample that completes
+            a window, so that its amplitudes can be read before going on.
+    @param  samples
+            Raw samples
+    @param  count
+            Number of samples
+    @return Number of samples used
+*/
+/**************************************************************************/
+uint16_t MSA300Goertzel::update(const rawAcc_t *samples, uint16_t count)
+{
+  _ready = false;
+  if (_window == 0 || count == 0) {
+    return count;
+  }
+
+  /* The first window is centered on its first sample, later ones on the
+     mean of the window before. Keeps gravity out of the low tones. */
+  if (!_centered) {
+    const int16_t *values = &samples[0].x;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      _center[axis] = values[axis] >> _shift;
+    }
+    _centered = true;
+  }
+  if (_count == 0) {
+    memset(_sum, 0, sizeof(_sum));
+  }
+
+  uint16_t batch = _window - _count;
+  if (batch > count) {
+    batch = count;
+  }
+
+  for (uint16_t i = 0; i < batch; i++) {
+    const int16_t *values = &samples[i].x;
+    int32_t centered[3];
+
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      int16_t value = values[axis] >> _shift;
+      _sum[axis] += value;
+      centered[axis] = value - _center[axis];
+    }
+
+    for (uint8_t tone = 0; tone < _tones; tone++) {
+      int32_t s0 = centered[_axis[tone]] +
+                   (int32_t)(((int64_t)_coeff[tone] * _s1[tone]) >> MSA300_GOERTZEL_Q) - _s2[tone];
+      _s2[tone] = _s1[tone];
+      _s1[tone] = s0;
+    }
+  }
+
+  _count += batch;
+  if (_count == _window) {
+    finishWindow();
+  }
+
+  return batch;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Turn the filter states into amplitudes and start a new window
+*/
+/**************************************************************************/
+void MSA300Goertzel::finishWindow(void)
+{
+  float scale = 2.0f * _mgPerLsb / _window;
+
+  for (uint8_t tone = 0; tone < _tones; tone++) {
+    float w = 2.0f * (float)M_PI * _frequency[tone] / _sampleRate;
+    float s1 = (float)_s1[tone];
+    float s2 = (float)_s2[tone];
+    float re = s1 - cosf(w) * s2;
+    float im = sinf(w) * s2;
+
+    /* Nyquist has no conjugate twin, it carries all of its amplitude */
+    _amplitude[tone] = sqrtf(re * re + im * im) * scale;
+    if (2 * _frequency[tone] >= _sampleRate) {
+      _amplitude[tone] *= 0.5f;
+    }
+    _s1[tone] = 0;
+    _s2[tone] = 0;
+  }
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    _center[axis] = (int16_t)(_sum[axis] / _window);
+  }
+  _count = 0;
+  _ready = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if the last update completed a window
+    @return True if amplitudes of a new window are available
+*/
+/**************************************************************************/
+bool MSA300Goertzel::ready(void)
+{
+  return _ready;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the amplitude of a tone in the last completed window
+    @param  tone
+            Index returned by addTone()
+    @return Peak amplitude in mg, 0 before the first window
+*/
+/**************************************************************************/
+float MSA300Goertzel::amplitude(uint8_t tone)
+{
+  return (tone < _tones) ? _amplitude[tone] : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the frequency of a tone
+    @param  tone
+            Index returned by addTone()
+    @return Frequency in Hz
+*/
+/**************************************************************************/
+float MSA300Goertzel::frequency(uint8_t tone)
+{
+  return (tone < _tones) ? _frequency[tone] : 0;
+}
@@ -0,0 +1,73 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Goertzel.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Narrowband tone tracking with a bank of Goertzel filters.
+
+    Each tone is a frequency on one axis. Every sample costs one fixed
+    point multiply-accumulate per tone, so a few known machine
+    frequencies are far cheaper to follow than a full spectrum. The
+    amplitude of every tone is reported per window. Frequencies do not
+    have to fall on a bin, and the resolution is the data rate divided by
+    the window length.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_GOERTZEL_H
+#define MSA300_GOERTZEL_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    GOERTZEL
+    -----------------------------------------------------------------------*/
+    #define MSA300_GOERTZEL_MAX_TONES       (8)       ///< Number of tones in the bank
+    #define MSA300_GOERTZEL_MAX_WINDOW      (1024)    ///< Longest window, keeps the filter states in 32 bits
+/*=========================================================================*/
+
+/** Class for a Goertzel filter bank. Storage is static, nothing is allocated. */
+class MSA300Goertzel{
+ public:
+  MSA300Goertzel(void);
+
+  bool        begin(uint16_t windowSamples, dataRate_t dataRate, range_t range, res_t resolution);
+  int8_t      addTone(float frequency, axis_t axis);
+  void        clearTones(void);
+  uint8_t     getTones(void);
+
+  bool        update(const rawAcc_t *sample);
+  uint16_t    update(const rawAcc_t *samples, uint16_t count);
+  bool        ready(void);
+  float       amplitude(uint8_t tone);
+  float       frequency(uint8_t tone);
+
+ private:
+  void        finishWindow(void);
+
+  uint16_t    _window;
+  uint16_t    _count;
+  float       _sampleRate;
+  uint8_t     _shift;
+  float       _mgPerLsb;
+  bool        _ready;
+  bool        _centered;
+  int16_t     _center[3];
+  int32_t     _sum[3];
+
+  uint8_t     _tones;
+  float       _frequency[MSA300_GOERTZEL_MAX_TONES];
+  uint8_t     _axis[MSA300_GOERTZEL_MAX_TONES];
+  int32_t     _coeff[MSA300_GOERTZEL_MAX_TONES];
+  int32_t     _s1[MSA300_GOERTZEL_MAX_TONES];
+  int32_t     _s2[MSA300_GOERTZEL_MAX_TONES];
+  float       _amplitude[MSA300_GOERTZEL_MAX_TONES];
+};
+
+#endif // MSA300_GOERTZEL_H
@@ -0,0 +1,421 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Log.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Binary capture file format for raw MSA300 samples
+*/
+/**************************************************************************/
+#include "MSA300Log.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* The format is written straight from memory, make sure the layout is the documented one */
+static_assert(sizeof(msa300LogHeader_t) == 24, "Unexpected log header size");
+static_assert(sizeof(msa300LogBlock_t) == 8, "Unexpected log block size");
+static_assert(sizeof(rawAcc_t) == 6, "Unexpected sample size");
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new capture writer
+    @param  out
+            Sink the capture is written to
+*/
+/**************************************************************************/
+MSA300LogWriter::MSA300LogWriter(Print &out)
+{
+  _out = &out;
+  _blockSamples = 0;
+  _blocks = 0;
+  _lastTimestamp = 0;
+  _epoch = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write bytes to the sink
+    @param  data
+            Bytes to be written
+    @param  len
+            Number of bytes
+    @return True if all bytes were written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::writeBytes(const void *data, size_t len)
+{
+  return _out->write((const uint8_t *)data, len) == len;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write a block header. A timestamp below the previous one means
+            micros() wrapped, which starts the next epoch. Blocks must
+            start less than 71 minutes apart for every wrap to be seen.
+    @param  count
+            Number of valid samples in the block
+    @param  timestamp
+            Time of the first sample in microseconds
+    @return True if the header was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::writeHeader(uint16_t count, uint32_t timestamp)
+{
+  if (_blocks > 0 && timestamp < _lastTimestamp) {
+    _epoch++;
+  }
+  _lastTimestamp = timestamp;
+
+  msa300LogBlock_t block;
+  block.timestamp = timestamp;
+  block.count = count;
+  block.epoch = _epoch;
+
+  return writeBytes(&block, sizeof(block));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write zeroed samples to fill up a partial block, then pad the
+            block to a multiple of 4 bytes
+    @param  count
+            Number of samples to pad
+    @return True if all padding was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::writePadding(uint16_t count)
+{
+  static const rawAcc_t padding = {0, 0, 0};
+
+  for (uint16_t i = 0; i < count; i++) {
+    if (!writeBytes(&padding, sizeof(padding))) {
+      return false;
+    }
+  }
+
+  /* Odd sample counts leave the next block header 2 bytes off */
+  if (_blockSamples & 1) {
+    return writeBytes(&padding, 2);
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read the sensor configuration and write the capture header
+    @param  accel
+            Sensor the samples are captured from
+    @param  blockSamples
+            Number of samples per block
+    @return True if the header was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::begin(MSA300 &accel, uint16_t blockSamples)
+{
+  msa300LogHeader_t header;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MSA300_LOG_MAGIC, sizeof(header.magic));
+  header.version = MSA300_LOG_VERSION;
+
+  uint8_t format = accel.readRegister(MSA300_REG_RES_RANGE);
+  header.range = format & 0x3;
+  header.resolution = (format >> 2) & 0x3;
+  header.dataRate = accel.readRegister(MSA300_REG_ODR) & 0x0F;
+  header.mode = (accel.readRegister(MSA300_REG_PWR_MODE_BW) >> 6) & 0x3;
+  accel.readRegisters(MSA300_REG_OFFSET_COMP_X, header.offset, sizeof(header.offset));
+  header.sensorID = accel.getSensorID();
+  header.blockSamples = blockSamples;
+  header.headerSize = sizeof(header);
+
+  _blockSamples = blockSamples;
+  _blocks = 0;
+  _lastTimestamp = 0;
+  _epoch = 0;
+
+  return writeBytes(&header, sizeof(header));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write one block. Blocks shorter than blockSamples are padded so
+            every block has the same size in the file.
+    @param  samples
+            Samples to be written
+    @param  count
+            Number of samples (at most blockSamples)
+    @param  timestamp
+            Time of the first sample in microseconds
+    @return True if the block was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::writeBlock(const rawAcc_t *samples, uint16_t count, uint32_t timestamp)
+{
+  count = clamp<uint16_t>(count, 0, _blockSamples);
+
+  if (!writeHeader(count, timestamp) || !writeBytes(samples, count * sizeof(rawAcc_t))) {
+    return false;
+  }
+
+  if (!writePadding(_blockSamples - count)) {
+    return false;
+  }
+
+  _blocks++;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write one full block from the sample buffer. Nothing is written
+            until the buffer holds at least blockSamples samples.
+    @param  buffer
+            Sample buffer to drain
+    @param  timestamp
+            Time of the oldest sample in the buffer in microseconds
+    @return True if a block was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::write(MSA300Buffer &buffer, uint32_t timestamp)
+{
+  if (_blockSamples == 0 || buffer.available() < _blockSamples) {
+    return false;
+  }
+
+  return flush(buffer, timestamp);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write up to one block from the sample buffer, even a partial one.
+    @param  buffer
+            Sample buffer to drain
+    @param  timestamp
+            Time of the oldest sample in the buffer in microseconds
+    @return True if a block was written
+*/
+/**************************************************************************/
+bool MSA300LogWriter::flush(MSA300Buffer &buffer, uint32_t timestamp)
+{
+  uint16_t count = clamp<uint16_t>(buffer.available(), 0, _blockSamples);
+  if (count == 0) {
+    return false;
+  }
+
+  if (!writeHeader(count, timestamp)) {
+    return false;
+  }
+
+  /* Samples may wrap around the end of the ring, write both halves */
+  uint16_t remaining = count;
+  while (remaining > 0) {
+    const rawAcc_t *samples;
+    uint16_t span = clamp<uint16_t>(buffer.readSpan(&samples), 0, remaining);
+    if (!writeBytes(samples, span * sizeof(rawAcc_t))) {
+      return false;
+    }
+    buffer.consume(span);
+    remaining -= span;
+  }
+
+  if (!writePadding(_blockSamples - count)) {
+    return false;
+  }
+
+  _blocks++;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of blocks written since begin()
+    @return Number of blocks
+*/
+/**************************************************************************/
+uint32_t MSA300LogWriter::blocksWritten(void)
+{
+  return _blocks;
+}
+
+#if defined(__linux__)
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new capture reader
+*/
+/**************************************************************************/
+MSA300LogReader::MSA300LogReader(void)
+{
+  _data = NULL;
+  _size = 0;
+  _stride = 0;
+  _blocks = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Unmaps the capture
+*/
+/**************************************************************************/
+MSA300LogReader::~MSA300LogReader(void)
+{
+  close();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Map a capture file. Only the header is validated, blocks are
+            paged in by the kernel when they are first accessed.
+    @param  path
+            Path of the capture file
+    @retval True
+            Capture was mapped
+    @retval False
+            File could not be mapped or is not a capture
+*/
+/**************************************************************************/
+bool MSA300LogReader::open(const char *path)
+{
+  close();
+
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(msa300LogHeader_t)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  _data = (const uint8_t *)data;
+  _size = st.st_size;
+
+  const msa300LogHeader_t *hdr = header();
+  if (memcmp(hdr->magic, MSA300_LOG_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->version < 1 || hdr->version > MSA300_LOG_VERSION ||
+      hdr->headerSize < sizeof(msa300LogHeader_t) || hdr->headerSize > _size ||
+      (hdr->headerSize & 1) != 0 || hdr->blockSamples == 0) {
+    close();
+    return false;
+  }
+
+  _stride = sizeof(msa300LogBlock_t) + (size_t)hdr->blockSamples * sizeof(rawAcc_t);
+  if (hdr->version >= 2) {
+    _stride = (_stride + 3) & ~(size_t)3;
+  }
+  _blocks = (_size - hdr->headerSize) / _stride;
+
+  madvise((void *)_data, _size, MADV_SEQUENTIAL);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Unmap the capture
+*/
+/**************************************************************************/
+void MSA300LogReader::close(void)
+{
+  if (_data != NULL) {
+    munmap((void *)_data, _size);
+  }
+
+  _data = NULL;
+  _size = 0;
+  _stride = 0;
+  _blocks = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the capture header
+    @return Header or NULL if no capture is open
+*/
+/**************************************************************************/
+const msa300LogHeader_t *MSA300LogReader::header(void)
+{
+  return (const msa300LogHeader_t *)_data;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of complete blocks in the capture
+    @return Number of blocks
+*/
+/**************************************************************************/
+size_t MSA300LogReader::blockCount(void)
+{
+  return _blocks;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of samples in the capture. Touches every block
+            header, so this is O(blocks).
+    @return Number of valid samples
+*/
+/**************************************************************************/
+uint64_t MSA300LogReader::sampleCount(void)
+{
+  uint64_t count = 0;
+  msa300LogSpan_t span;
+
+  for (size_t i = 0; i < _blocks; i++) {
+    block(i, &span);
+    count += span.count;
+  }
+
+  return count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get a view of one block. The samples point into the mapping and
+            stay valid until close().
+    @param  index
+            Index of the block
+    @param  span
+            Span to be filled
+    @return True if index was inside the capture
+*/
+/**************************************************************************/
+bool MSA300LogReader::block(size_t index, msa300LogSpan_t *span)
+{
+  if (index >= _blocks) {
+    return false;
+  }
+
+  const uint8_t *base = _data + header()->headerSize + index * _stride;
+
+  /* Version 1 block headers can sit on any even address */
+  msa300LogBlock_t block;
+  memcpy(&block, base, sizeof(block));
+
+  span->timestamp = ((uint64_t)block.epoch << 32) | block.timestamp;
+  span->count = clamp<uint16_t>(block.count, 0, header()->blockSamples);
+  span->samples = (const rawAcc_t *)(base + sizeof(msa300LogBlock_t));
+
+  return true;
+}
+
+#endif
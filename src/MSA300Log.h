@@ -0,0 +1,120 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Log.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Binary capture file format for raw MSA300 samples.
+
+    A capture starts with a msa300LogHeader_t describing the sensor
+    configuration, followed by fixed size blocks. Every block is a
+    msa300LogBlock_t header and blockSamples raw samples, padded to a
+    multiple of 4 bytes so every block header is aligned. The last block
+    may be only partially filled, its count field tells how many samples
+    are valid. Block timestamps are 32 bit microseconds plus an epoch
+    counting their wraps, so captures can run for years. All fields are
+    little endian.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_LOG_H
+#define MSA300_LOG_H
+
+#include "MSA300.h"
+#include "MSA300Buffer.h"
+
+/*=========================================================================
+    LOG FORMAT
+    -----------------------------------------------------------------------*/
+    #define MSA300_LOG_MAGIC            "MSA3"    ///< File magic
+    #define MSA300_LOG_VERSION          (2)       ///< Format version. Version 1 had no block padding and no epoch
+/*=========================================================================*/
+
+/** Capture file header. Register fields hold the raw register bit values. */
+typedef struct
+{
+  char     magic[4];        ///< MSA300_LOG_MAGIC
+  uint8_t  version;         ///< MSA300_LOG_VERSION
+  uint8_t  range;           ///< range_t at capture time
+  uint8_t  resolution;      ///< res_t at capture time
+  uint8_t  dataRate;        ///< dataRate_t at capture time
+  uint8_t  mode;            ///< pwrMode_t at capture time
+  uint8_t  offset[3];       ///< OFFSET_COMP_X/Y/Z register values
+  int32_t  sensorID;        ///< ID of the capturing sensor
+  uint16_t blockSamples;    ///< Samples per block
+  uint16_t headerSize;      ///< Size of this header in bytes
+  uint32_t reserved;        ///< Reserved, written as zero
+} msa300LogHeader_t;
+
+/** Block header. Followed by msa300LogHeader_t::blockSamples raw samples. */
+typedef struct
+{
+  uint32_t timestamp;       ///< Time of the first sample in microseconds, low 32 bits
+  uint16_t count;           ///< Number of valid samples in the block
+  uint16_t epoch;           ///< Wraps of timestamp since the capture started (zero in version 1)
+} msa300LogBlock_t;
+
+/** View of one block inside a mapped capture */
+typedef struct
+{
+  uint64_t        timestamp;  ///< Time of the first sample in microseconds, epoch included
+  uint16_t        count;      ///< Number of valid samples
+  const rawAcc_t *samples;    ///< Samples of the block
+} msa300LogSpan_t;
+
+/** Class for writing captures to any Print sink (SD card File, Serial, ...) */
+class MSA300LogWriter{
+ public:
+  MSA300LogWriter(Print &out);
+
+  bool        begin(MSA300 &accel, uint16_t blockSamples);
+  bool        writeBlock(const rawAcc_t *samples, uint16_t count, uint32_t timestamp);
+  bool        write(MSA300Buffer &buffer, uint32_t timestamp);
+  bool        flush(MSA300Buffer &buffer, uint32_t timestamp);
+
+  uint32_t    blocksWritten(void);
+
+ private:
+  bool        writeBytes(const void *data, size_t len);
+  bool        writeHeader(uint16_t count, uint32_t timestamp);
+  bool        writePadding(uint16_t count);
+
+  Print   *_out;
+  uint16_t _blockSamples;
+  uint32_t _blocks;
+  uint32_t _lastTimestamp;
+  uint16_t _epoch;
+};
+
+#if defined(__linux__)
+/** Class for reading captures on Linux. The file is memory mapped, so opening is independent of its size. */
+class MSA300LogReader{
+ public:
+  MSA300LogReader(void);
+  ~MSA300LogReader(void);
+
+  bool        open(const char *path);
+  void        close(void);
+
+  const msa300LogHeader_t *header(void);
+  size_t      blockCount(void);
+  uint64_t    sampleCount(void);
+  bool        block(size_t index, msa300LogSpan_t *span);
+
+ private:
+  MSA300LogReader(const MSA300LogReader &);
+  MSA300LogReader &operator=(const MSA300LogReader &);
+
+  const uint8_t *_data;
+  size_t   _size;
+  size_t   _stride;
+  size_t   _blocks;
+};
+#endif
+
+#endif // MSA300_LOG_H
@@ -0,0 +1,427 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Pack.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Bit-packing of raw MSA300 samples to the configured resolution
+*/
+/**************************************************************************/
+#include "MSA300Pack.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MSA300_PACK_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MSA300_PACK_NEON
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Write one value into a bit stream
+    @param  packed
+            Bit stream
+    @param  offset
+            Bit offset of the value
+    @param  bits
+            Width of the value
+    @param  value
+            Raw register word, only its top bits are stored
+*/
+/**************************************************************************/
+static inline void putBits(uint8_t *packed, uint32_t offset, uint8_t bits, int16_t value)
+{
+  uint32_t field = ((uint16_t)value >> (16 - bits)) << (offset & 7);
+  uint32_t mask = (((uint32_t)1 << bits) - 1) << (offset & 7);
+  uint8_t *p = &packed[offset >> 3];
+
+  for (uint8_t i = 0; mask != 0; i++) {
+    p[i] = (p[i] & ~(uint8_t)mask) | (uint8_t)field;
+    mask >>= 8;
+    field >>= 8;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read one value from a bit stream
+    @param  packed
+            Bit stream
+    @param  offset
+            Bit offset of the value
+    @param  bits
+            Width of the value
+    @return Value as a left aligned raw register word
+*/
+/**************************************************************************/
+static inline int16_t getBits(const uint8_t *packed, uint32_t offset, uint8_t bits)
+{
+  const uint8_t *p = &packed[offset >> 3];
+  uint8_t shift = offset & 7;
+  uint8_t bytes = (shift + bits + 7) >> 3;
+  uint32_t field = 0;
+
+  for (uint8_t i = 0; i < bytes; i++) {
+    field |= (uint32_t)p[i] << (8 * i);
+  }
+
+  return (int16_t)(uint16_t)((field >> shift) << (16 - bits));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of bytes needed for packed samples
+    @param  count
+            Number of samples
+    @param  resolution
+            Measurement resolution
+    @return Size in bytes
+*/
+/**************************************************************************/
+uint32_t packedSize(uint32_t count, res_t resolution)
+{
+  return (count * 3 * resolutionBits(resolution) + 7) / 8;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Pack samples to the given resolution. Host builds use SSE2 or
+            NEON for all three widths.
+    @param  samples
+            Raw samples
+    @param  count
+            Number of samples
+    @param  resolution
+            Measurement resolution
+    @param  packed
+            Output, packedSize(count, resolution) bytes
+*/
+/**************************************************************************/
+void packSamples(const rawAcc_t *samples, uint32_t count, res_t resolution, uint8_t *packed)
+{
+  const int16_t *in = &samples->x;
+  uint32_t values = count * 3;
+  uint32_t i = 0;
+
+  switch(resolution) {
+    case MSA300_RES_8_BIT:
+#if defined(MSA300_PACK_SSE2)
+      for (; i + 16 <= values; i += 16) {
+        __m128i lo = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)&in[i]), 8);
+        __m128i hi = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)&in[i + 8]), 8);
+        _mm_storeu_si128((__m128i *)&packed[i], _mm_packs_epi16(lo, hi));
+      }
+#elif defined(MSA300_PACK_NEON)
+      for (; i + 8 <= values; i += 8) {
+        vst1_s8((int8_t *)&packed[i], vshrn_n_s16(vld1q_s16(&in[i]), 8));
+      }
+#endif
+      for (; i < values; i++) {
+        packed[i] = (uint8_t)((uint16_t)in[i] >> 8);
+      }
+      break;
+
+    case MSA300_RES_12_BIT:
+#if defined(MSA300_PACK_SSE2)
+      /* Pairs joined into 24-bit lanes, stored 3 bytes apart. The fourth
+         byte of the last lane is rewritten by the next pair. */
+      for (; i + 8 < values; i += 8) {
+        __m128i v = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)&in[i]), 4);
+        __m128i w = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)),
+                                 _mm_slli_epi32(_mm_srli_epi32(v, 16), 12));
+        uint8_t *p = &packed[i / 2 * 3];
+        for (uint8_t j = 0; j < 4; j++) {
+          uint32_t lane = (uint32_t)_mm_cvtsi128_si32(w);
+          memcpy(&p[j * 3], &lane, 4);
+          w = _mm_srli_si128(w, 4);
+        }
+      }
+#elif defined(MSA300_PACK_NEON)
+      for (; i + 16 <= values; i += 16) {
+        uint16x8x2_t v = vld2q_u16((const uint16_t *)&in[i]);
+        uint16x8_t a = vshrq_n_u16(v.val[0], 4);
+        uint16x8_t b = vshrq_n_u16(v.val[1], 4);
+        uint8x8x3_t p;
+        p.val[0] = vmovn_u16(a);
+        p.val[1] = vmovn_u16(vorrq_u16(vshrq_n_u16(a, 8), vshlq_n_u16(b, 4)));
+        p.val[2] = vshrn_n_u16(b, 4);
+        vst3_u8(&packed[i / 2 * 3], p);
+      }
+#endif
+      /* Two values fit exactly in three bytes */
+      for (; i + 2 <= values; i += 2) {
+        uint16_t a = (uint16_t)in[i] >> 4;
+        uint16_t b = (uint16_t)in[i + 1] >> 4;
+        uint8_t *p = &packed[i / 2 * 3];
+        p[0] = (uint8_t)a;
+        p[1] = (uint8_t)((a >> 8) | (b << 4));
+        p[2] = (uint8_t)(b >> 4);
+      }
+      if (i < values) {
+        uint16_t a = (uint16_t)in[i] >> 4;
+        uint8_t *p = &packed[i / 2 * 3];
+        p[0] = (uint8_t)a;
+        p[1] = (uint8_t)(a >> 8);
+      }
+      break;
+
+    case MSA300_RES_14_BIT:
+    default:
+#if defined(MSA300_PACK_SSE2) || defined(MSA300_PACK_NEON)
+      /* Four values fit exactly in seven bytes. Quads are joined into 56-bit
+         lanes and stored 7 bytes apart, the last byte of the second lane is
+         rewritten by the next quad or cleared below. */
+      for (; i + 8 < values; i += 8) {
+        uint8_t *p = &packed[i / 8 * 14];
+#if defined(MSA300_PACK_SSE2)
+        __m128i v = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)&in[i]), 2);
+        __m128i w = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(0xFFFF)),
+                                 _mm_slli_epi32(_mm_srli_epi32(v, 16), 14));
+        __m128i q = _mm_or_si128(_mm_and_si128(w, _mm_set_epi32(0, -1, 0, -1)),
+                                 _mm_slli_epi64(_mm_srli_epi64(w, 32), 28));
+        _mm_storel_epi64((__m128i *)p, q);
+        _mm_storel_epi64((__m128i *)&p[7], _mm_unpackhi_epi64(q, q));
+#else
+        uint32x4_t v = vreinterpretq_u32_u16(vshrq_n_u16(vld1q_u16((const uint16_t *)&in[i]), 2));
+        uint64x2_t w = vreinterpretq_u64_u32(vorrq_u32(vandq_u32(v, vdupq_n_u32(0xFFFF)),
+                                                       vshlq_n_u32(vshrq_n_u32(v, 16), 14)));
+        uint64x2_t q = vorrq_u64(vandq_u64(w, vdupq_n_u64(0xFFFFFFFF)),
+                                 vshlq_n_u64(vshrq_n_u64(w, 32), 28));
+        vst1_u8(p, vreinterpret_u8_u64(vget_low_u64(q)));
+        vst1_u8(&p[7], vreinterpret_u8_u64(vget_high_u64(q)));
+#endif
+      }
+#endif
+      memset(&packed[i / 8 * 14], 0, packedSize(count, resolution) - i / 8 * 14);
+      for (; i < values; i++) {
+        putBits(packed, i * 14, 14, in[i]);
+      }
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Unpack samples back to left aligned raw register words. Host
+            builds use SSE2 or NEON for all three widths.
+    @param  packed
+            Packed samples
+    @param  count
+            Number of samples
+    @param  resolution
+            Resolution the samples were packed with
+    @param  samples
+            Output raw samples
+*/
+/**************************************************************************/
+void unpackSamples(const uint8_t *packed, uint32_t count, res_t resolution, rawAcc_t *samples)
+{
+  int16_t *out = &samples->x;
+  uint32_t values = count * 3;
+  uint32_t i = 0;
+
+  switch(resolution) {
+    case MSA300_RES_8_BIT:
+#if defined(MSA300_PACK_SSE2)
+      for (; i + 16 <= values; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)&packed[i]);
+        __m128i zero = _mm_setzero_si128();
+        _mm_storeu_si128((__m128i *)&out[i], _mm_unpacklo_epi8(zero, v));
+        _mm_storeu_si128((__m128i *)&out[i + 8], _mm_unpackhi_epi8(zero, v));
+      }
+#elif defined(MSA300_PACK_NEON)
+      for (; i + 8 <= values; i += 8) {
+        vst1q_s16(&out[i], vshll_n_s8(vld1_s8((const int8_t *)&packed[i]), 8));
+      }
+#endif
+      for (; i < values; i++) {
+        out[i] = (int16_t)((uint16_t)packed[i] << 8);
+      }
+      break;
+
+    case MSA300_RES_12_BIT:
+#if defined(MSA300_PACK_SSE2)
+      /* The 16 byte load needs 11 values of input */
+      for (; i + 11 <= values; i += 8) {
+        __m128i r = _mm_loadu_si128((const __m128i *)&packed[i / 2 * 3]);
+        __m128i w = _mm_unpacklo_epi64(_mm_unpacklo_epi32(r, _mm_srli_si128(r, 3)),
+                                       _mm_unpacklo_epi32(_mm_srli_si128(r, 6), _mm_srli_si128(r, 9)));
+        __m128i a = _mm_and_si128(w, _mm_set1_epi32(0xFFF));
+        __m128i b = _mm_slli_epi32(_mm_srli_epi32(w, 12), 16);
+        _mm_storeu_si128((__m128i *)&out[i], _mm_slli_epi16(_mm_or_si128(a, b), 4));
+      }
+#elif defined(MSA300_PACK_NEON)
+      for (; i + 16 <= values; i += 16) {
+        uint8x8x3_t p = vld3_u8(&packed[i / 2 * 3]);
+        uint16x8x2_t v;
+        v.val[0] = vshlq_n_u16(vorrq_u16(vmovl_u8(p.val[0]), vshlq_n_u16(vmovl_u8(p.val[1]), 8)), 4);
+        v.val[1] = vshlq_n_u16(vorrq_u16(vmovl_u8(vshr_n_u8(p.val[1], 4)), vshlq_n_u16(vmovl_u8(p.val[2]), 4)), 4);
+        vst2q_u16((uint16_t *)&out[i], v);
+      }
+#endif
+      for (; i + 2 <= values; i += 2) {
+        const uint8_t *p = &packed[i / 2 * 3];
+        out[i] = (int16_t)(uint16_t)((p[0] | (p[1] << 8)) << 4);
+        out[i + 1] = (int16_t)(uint16_t)(((p[1] >> 4) | (p[2] << 4)) << 4);
+      }
+      if (i < values) {
+        const uint8_t *p = &packed[i / 2 * 3];
+        out[i] = (int16_t)(uint16_t)((p[0] | (p[1] << 8)) << 4);
+      }
+      break;
+
+    case MSA300_RES_14_BIT:
+    default:
+#if defined(MSA300_PACK_SSE2) || defined(MSA300_PACK_NEON)
+      for (; i + 8 < values; i += 8) {
+        const uint8_t *p = &packed[i / 8 * 14];
+#if defined(MSA300_PACK_SSE2)
+        __m128i q = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)p),
+                                       _mm_loadl_epi64((const __m128i *)&p[7]));
+        __m128i quad = _mm_set_epi32(0, 0x0FFFFFFF, 0, 0x0FFFFFFF);
+        __m128i w = _mm_or_si128(_mm_and_si128(q, quad),
+                                 _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(q, 28), quad), 32));
+        __m128i v = _mm_or_si128(_mm_and_si128(w, _mm_set1_epi32(0x3FFF)),
+                                 _mm_slli_epi32(_mm_srli_epi32(w, 14), 16));
+        _mm_storeu_si128((__m128i *)&out[i], _mm_slli_epi16(v, 2));
+#else
+        uint64x2_t q = vcombine_u64(vreinterpret_u64_u8(vld1_u8(p)),
+                                    vreinterpret_u64_u8(vld1_u8(&p[7])));
+        uint64x2_t quad = vdupq_n_u64(0x0FFFFFFF);
+        uint32x4_t w = vreinterpretq_u32_u64(vorrq_u64(vandq_u64(q, quad),
+                                                       vshlq_n_u64(vandq_u64(vshrq_n_u64(q, 28), quad), 32)));
+        uint32x4_t v = vorrq_u32(vandq_u32(w, vdupq_n_u32(0x3FFF)),
+                                 vshlq_n_u32(vshrq_n_u32(w, 14), 16));
+        vst1q_u16((uint16_t *)&out[i], vshlq_n_u16(vreinterpretq_u16_u32(v), 2));
+#endif
+      }
+#endif
+      for (; i < values; i++) {
+        out[i] = getBits(packed, i * 14, 14);
+      }
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new packed sample ring
+    @param  storage
+            Storage for the packed samples
+    @param  size
+            Size of the storage in bytes
+    @param  resolution
+            Resolution samples are stored with
+*/
+/**************************************************************************/
+MSA300PackedBuffer::MSA300PackedBuffer(uint8_t *storage, uint32_t size, res_t resolution)
+{
+  _storage = storage;
+  _res = resolution;
+  _bits = resolutionBits(resolution);
+  _capacity = size * 8 / (3 * _bits);
+  clear();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Store a sample, overwriting the oldest one when full
+    @param  sample
+            Raw sample
+*/
+/**************************************************************************/
+void MSA300PackedBuffer::push(const rawAcc_t *sample)
+{
+  if (_capacity == 0) {
+    return;
+  }
+
+  uint32_t offset = _head * 3 * _bits;
+  putBits(_storage, offset, _bits, sample->x);
+  putBits(_storage, offset + _bits, _bits, sample->y);
+  putBits(_storage, offset + 2 * _bits, _bits, sample->z);
+
+  _head = (_head + 1 == _capacity) ? 0 : _head + 1;
+  if (_count < _capacity) {
+    _count++;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read a stored sample
+    @param  index
+            Position counted from the oldest sample
+    @param  sample
+            Sample struct to be filled with data
+    @return True if index was inside the buffer
+*/
+/**************************************************************************/
+bool MSA300PackedBuffer::get(uint32_t index, rawAcc_t *sample)
+{
+  if (index >= _count) {
+    return false;
+  }
+
+  uint32_t position = _head + _capacity - _count + index;
+  if (position >= _capacity) {
+    position -= _capacity;
+  }
+
+  uint32_t offset = position * 3 * _bits;
+  sample->x = getBits(_storage, offset, _bits);
+  sample->y = getBits(_storage, offset + _bits, _bits);
+  sample->z = getBits(_storage, offset + 2 * _bits, _bits);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop all samples
+*/
+/**************************************************************************/
+void MSA300PackedBuffer::clear(void)
+{
+  _head = 0;
+  _count = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of stored samples
+    @return Number of samples
+*/
+/**************************************************************************/
+uint32_t MSA300PackedBuffer::available(void)
+{
+  return _count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of samples that fit in the storage
+    @return Maximum number of samples
+*/
+/**************************************************************************/
+uint32_t MSA300PackedBuffer::capacity(void)
+{
+  return _capacity;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the resolution samples are stored with
+    @return Measurement resolution
+*/
+/**************************************************************************/
+res_t MSA300PackedBuffer::getResolution(void)
+{
+  return _res;
+}
@@ -0,0 +1,53 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Pack.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Bit-packing of raw MSA300 samples to the configured resolution.
+
+    Every axis is stored with exactly resolutionBits() bits, most
+    significant bits of the raw register word first truncated to that
+    width. Values are packed LSB first into a little endian bit stream in
+    x, y, z order, so a sample takes 3, 4.5 or 5.25 bytes for 8, 12 or
+    14 bit resolution.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_PACK_H
+#define MSA300_PACK_H
+
+#include "MSA300.h"
+
+uint32_t    packedSize(uint32_t count, res_t resolution);
+void        packSamples(const rawAcc_t *samples, uint32_t count, res_t resolution, uint8_t *packed);
+void        unpackSamples(const uint8_t *packed, uint32_t count, res_t resolution, rawAcc_t *samples);
+
+/** Ring of bit-packed samples. Keeps the most recent samples, overwriting the oldest when full. Storage is supplied by the caller. */
+class MSA300PackedBuffer{
+ public:
+  MSA300PackedBuffer(uint8_t *storage, uint32_t size, res_t resolution);
+
+  void        push(const rawAcc_t *sample);
+  bool        get(uint32_t index, rawAcc_t *sample);
+  void        clear(void);
+
+  uint32_t    available(void);
+  uint32_t    capacity(void);
+  res_t       getResolution(void);
+
+ private:
+  uint8_t *_storage;
+  uint32_t _capacity;
+  res_t    _res;
+  uint8_t  _bits;
+  uint32_t _head;
+  uint32_t _count;
+};
+
+#endif // MSA300_PACK_H
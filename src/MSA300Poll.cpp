@@ -0,0 +1,174 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Poll.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Interrupt polling for boards without a wired INT line
+*/
+/**************************************************************************/
+#include "MSA300Poll.h"
+
+/** Temporary latch modes ordered by duration */
+static const struct
+{
+  uint32_t  ms;
+  intMode_t mode;
+} latchModes[] = {
+  {1,    MSA300_INT_LATCHED_1_MS},
+  {2,    MSA300_INT_LATCHED_2_MS},
+  {25,   MSA300_INT_LATCHED_25_MS},
+  {50,   MSA300_INT_LATCHED_50_MS},
+  {100,  MSA300_INT_LATCHED_100_MS},
+  {250,  MSA300_INT_LATCHED_250_MS},
+  {500,  MSA300_INT_LATCHED_500_MS},
+  {1000, MSA300_INT_LATCHED_1_S},
+  {2000, MSA300_INT_LATCHED_2_S},
+  {4000, MSA300_INT_LATCHED_4_S},
+  {8000, MSA300_INT_LATCHED_8_S}
+};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new poller
+    @param  accel
+            Sensor to poll
+    @param  dispatcher
+            Optional dispatcher that receives raised events
+*/
+/**************************************************************************/
+MSA300Poller::MSA300Poller(MSA300 &accel, MSA300Dispatcher *dispatcher)
+{
+  _accel = &accel;
+  _dispatcher = dispatcher;
+  _period = 0;
+  _last = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the shortest latch mode that holds a status for
+            MSA300_POLL_LATCH_MARGIN poll periods, so an event raised just
+            after a poll survives a late next poll. Longer latches use
+            permanent latching.
+    @param  periodMs
+            Poll period in milliseconds
+    @return Interrupt mode
+*/
+/**************************************************************************/
+intMode_t MSA300Poller::latchFor(uint32_t periodMs)
+{
+  for (uint8_t i = 0; i < sizeof(latchModes) / sizeof(latchModes[0]); i++) {
+    if (latchModes[i].ms >= periodMs * MSA300_POLL_LATCH_MARGIN) {
+      return latchModes[i].mode;
+    }
+  }
+
+  return MSA300_INT_LATCHED;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Configure latching for the poll period and clear stale status
+    @param  periodMs
+            Poll period in milliseconds
+    @return Interrupt mode that was set
+*/
+/**************************************************************************/
+intMode_t MSA300Poller::begin(uint32_t periodMs)
+{
+  intMode_t mode = latchFor(periodMs);
+
+  _period = periodMs;
+  _accel->setInterruptLatch(mode);
+  _accel->resetInterrupt();
+
+  return mode;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Poll the status registers if a period has passed. Call often
+            from the main loop, it returns immediately between polls.
+    @param  nowMs
+            Current time in milliseconds, e.g. millis()
+    @param  interrupts
+            Optional, filled with the status when a poll found events
+    @return True if a poll found raised interrupts
+*/
+/**************************************************************************/
+bool MSA300Poller::poll(uint32_t nowMs, interrupt_t *interrupts)
+{
+  if (nowMs - _last < _period) {
+    return false;
+  }
+  _last = nowMs;
+
+  interrupt_t status = _accel->checkInterrupts();
+  if (!status.any()) {
+    return false;
+  }
+
+  _accel->resetInterrupt();
+
+  if (_dispatcher) {
+    _dispatcher->dispatch(status);
+  }
+  if (interrupts) {
+    *interrupts = status;
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the poll period
+    @return Period in milliseconds
+*/
+/**************************************************************************/
+uint32_t MSA300Poller::getPeriod(void)
+{
+  return _period;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Estimate the bus load of polling. A poll is one 4 byte status
+            burst read, every raised event adds one RESET_INT write.
+            I2C bytes take 9 clocks (ack included) plus start/stop,
+            SPI bytes take 8 clocks.
+    @param  pollHz
+            Poll rate in Hz
+    @param  busHz
+            Bus clock in Hz
+    @param  i2c
+            True for I2C, false for SPI
+    @param  eventHz
+            Expected rate of raised interrupts in Hz
+    @return Bus load estimate
+*/
+/**************************************************************************/
+busLoad_t MSA300Poller::estimateBusLoad(float pollHz, uint32_t busHz, bool i2c, float eventHz)
+{
+  busLoad_t load;
+
+  /* I2C read: address, register, repeated start address, data. Write: address, register, data. */
+  float readBytes = i2c ? 3 + 4 : 1 + 4;
+  float writeBytes = i2c ? 2 + 1 : 1 + 1;
+  float bitsPerByte = i2c ? 9 : 8;
+  float framingBits = i2c ? 2 : 0;
+
+  float readBits = readBytes * bitsPerByte + 2 * framingBits;
+  float writeBits = writeBytes * bitsPerByte + framingBits;
+
+  load.bytesPerSecond = pollHz * readBytes + eventHz * writeBytes;
+  load.utilization = (pollHz * readBits + eventHz * writeBits) / busHz;
+
+  return load;
+}
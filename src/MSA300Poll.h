@@ -0,0 +1,58 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Poll.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Interrupt polling for boards without a wired INT line.
+
+    The chip's motion engines keep running and latch their status for at
+    least MSA300_POLL_LATCH_MARGIN poll periods. Each poll is a single status burst read, and a
+    RESET_INT write only follows when something was raised.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_POLL_H
+#define MSA300_POLL_H
+
+#include "MSA300.h"
+#include "MSA300Dispatch.h"
+
+/*=========================================================================
+    POLLING
+    -----------------------------------------------------------------------*/
+    #define MSA300_POLL_LATCH_MARGIN        (2)       ///< Latch for at least this many poll periods, covers loop jitter
+/*=========================================================================*/
+
+/** Bus load estimate */
+typedef struct
+{
+  float bytesPerSecond;         ///< Bytes on the wire per second, addressing included
+  float utilization;            ///< Fraction of the bus bandwidth used (0 to 1)
+} busLoad_t;
+
+/** Class for polling latched interrupts */
+class MSA300Poller{
+ public:
+  MSA300Poller(MSA300 &accel, MSA300Dispatcher *dispatcher = NULL);
+
+  intMode_t   begin(uint32_t periodMs);
+  bool        poll(uint32_t nowMs, interrupt_t *interrupts = NULL);
+  uint32_t    getPeriod(void);
+
+  static intMode_t latchFor(uint32_t periodMs);
+  static busLoad_t estimateBusLoad(float pollHz, uint32_t busHz, bool i2c, float eventHz = 0);
+
+ private:
+  MSA300     *_accel;
+  MSA300Dispatcher *_dispatcher;
+  uint32_t    _period;
+  uint32_t    _last;
+};
+
+#endif // MSA300_POLL_H
@@ -0,0 +1,153 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Replay.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Replay of recorded captures through the driver and a simulated chip
+*/
+/**************************************************************************/
+#include "MSA300Replay.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new replay engine
+    @param  accel
+            Driver instance constructed on top of sim
+    @param  sim
+            Simulated chip
+*/
+/**************************************************************************/
+MSA300Replay::MSA300Replay(MSA300 &accel, MSA300Sim &sim)
+{
+  _accel = &accel;
+  _sim = &sim;
+  _handler = NULL;
+  _context = NULL;
+  _polling = false;
+  _line = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the handler called for every serviced interrupt
+    @param  handler
+            Event handler
+    @param  context
+            Pointer passed to the handler
+*/
+/**************************************************************************/
+void MSA300Replay::onEvent(replayHandler_t handler, void *context)
+{
+  _handler = handler;
+  _context = context;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Select how interrupts are serviced
+    @param  polling
+            True to call checkInterrupts() after every sample, false to
+            call it only on a rising edge of INT1 or INT2
+*/
+/**************************************************************************/
+void MSA300Replay::setPolling(bool polling)
+{
+  _polling = polling;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replay samples through the simulated chip
+    @param  samples
+            Raw samples recorded in the currently configured range
+    @param  count
+            Number of samples
+    @return Number of serviced interrupts
+*/
+/**************************************************************************/
+uint32_t MSA300Replay::run(const rawAcc_t *samples, uint32_t count)
+{
+  uint32_t events = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    _sim->feed(&samples[i]);
+
+    bool line = _sim->int1() || _sim->int2();
+    bool service = _polling || (line && !_line);
+    _line = line;
+
+    if (!service) {
+      continue;
+    }
+
+    interrupt_t interrupts = _accel->checkInterrupts();
+    events++;
+
+    if (_handler) {
+      _handler(_sim->time(), interrupts, _context);
+    }
+
+    /* Handler may have reset latched interrupts */
+    _line = _sim->int1() || _sim->int2();
+  }
+
+  return events;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Configure range, resolution and data rate the capture was
+            recorded with and reset(). Call before setting range dependent
+            thresholds.
+    @param  header
+            Capture header
+*/
+/**************************************************************************/
+void MSA300Replay::configure(const msa300LogHeader_t *header)
+{
+  _accel->setRange((range_t)header->range);
+  _accel->setResolution((res_t)header->resolution);
+  _accel->setDataRate((dataRate_t)header->dataRate);
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start a run from a clean chip: motion engines, interrupt status
+            and the interrupt line edge are cleared, the configuration is
+            kept. Call between runs over the same capture.
+*/
+/**************************************************************************/
+void MSA300Replay::reset(void)
+{
+  _sim->resetEngines();
+  _line = false;
+}
+
+#if defined(__linux__)
+/**************************************************************************/
+/*!
+    @brief  Replay a whole capture
+    @param  reader
+            Opened capture
+    @return Number of serviced interrupts
+*/
+/**************************************************************************/
+uint32_t MSA300Replay::run(MSA300LogReader &reader)
+{
+  uint32_t events = 0;
+  msa300LogSpan_t span;
+  for (size_t i = 0; i < reader.blockCount(); i++) {
+    reader.block(i, &span);
+    events += run(span.samples, span.count);
+  }
+
+  return events;
+}
+#endif
@@ -0,0 +1,54 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Replay.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Replay of recorded captures through the driver and a simulated chip.
+
+    Every recorded sample is fed to an MSA300Sim. When one of the INT lines
+    rises, the same code an interrupt handler would run is executed:
+    checkInterrupts() over the simulated bus. Nothing waits for real time,
+    so long captures replay in a fraction of their duration.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_REPLAY_H
+#define MSA300_REPLAY_H
+
+#include "MSA300.h"
+#include "MSA300Sim.h"
+#include "MSA300Log.h"
+
+/** Event handler. Called with the simulated time in microseconds and the decoded interrupts. */
+typedef void (*replayHandler_t)(uint32_t time, const interrupt_t &interrupts, void *context);
+
+/** Class for replaying captures */
+class MSA300Replay{
+ public:
+  MSA300Replay(MSA300 &accel, MSA300Sim &sim);
+
+  void        onEvent(replayHandler_t handler, void *context);
+  void        setPolling(bool polling);
+  void        configure(const msa300LogHeader_t *header);
+  void        reset(void);
+  uint32_t    run(const rawAcc_t *samples, uint32_t count);
+#if defined(__linux__)
+  uint32_t    run(MSA300LogReader &reader);
+#endif
+
+ private:
+  MSA300     *_accel;
+  MSA300Sim  *_sim;
+  replayHandler_t _handler;
+  void       *_context;
+  bool        _polling;
+  bool        _line;
+};
+
+#endif // MSA300_REPLAY_H
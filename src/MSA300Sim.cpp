@@ -0,0 +1,653 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Sim.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Simulated MSA300 register map
+*/
+/**************************************************************************/
+#include "MSA300Sim.h"
+
+/** Status bits. Bits 0-6 follow MSA300_REG_MOTION_INT, bit 7 is new data. */
+enum
+{
+  STATUS_FREEFALL             = 0,
+  STATUS_ACTIVE               = 2,
+  STATUS_DOUBLE_TAP           = 4,
+  STATUS_SINGLE_TAP           = 5,
+  STATUS_ORIENT               = 6,
+  STATUS_NEW_DATA             = 7
+};
+
+/** Tap engine states */
+enum
+{
+  TAP_IDLE,
+  TAP_SHOCK,
+  TAP_QUIET
+};
+
+/** Latch durations in microseconds indexed by intMode_t. 0 = non latched, UINT32_MAX = permanent. */
+static const uint32_t latchDuration[16] = {
+  0, 250000, 500000, 1000000, 2000000, 4000000, 8000000, UINT32_MAX,
+  0, 1000, 1000, 2000, 25000, 50000, 100000, UINT32_MAX
+};
+
+/** Tap second shock window in microseconds indexed by tapDuration_t */
+static const uint32_t tapWindow[8] = {
+  50000, 100000, 150000, 200000, 250000, 375000, 500000, 700000
+};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new simulated chip in its reset state
+*/
+/**************************************************************************/
+MSA300Sim::MSA300Sim(void)
+{
+  reset();
+  resetCounters();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Put the simulated chip in its reset state
+*/
+/**************************************************************************/
+void MSA300Sim::reset(void)
+{
+  memset(_regs, 0, sizeof(_regs));
+  _regs[MSA300_REG_ODR] = MSA300_DATARATE_1000_HZ;
+
+  _time = 0;
+  resetEngines();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Clear the motion engines and the interrupt status, keeping the
+            configuration and the time. Makes repeated runs over the same
+            samples independent of each other.
+*/
+/**************************************************************************/
+void MSA300Sim::resetEngines(void)
+{
+  _regs[MSA300_REG_MOTION_INT] = 0;
+  _regs[MSA300_REG_DATA_INT] = 0;
+  _regs[MSA300_REG_TAP_ACTIVE_STATUS] = 0;
+  _regs[MSA300_REG_ORIENT_STATUS] = 0;
+
+  memset(_raisedAt, 0, sizeof(_raisedAt));
+  _pending = 0;
+  _hasPrev = false;
+  _activeCount = 0;
+  _freefall = false;
+  _freefallStart = 0;
+  _tapState = TAP_IDLE;
+  _tapStart = 0;
+  _firstTapAt = 0;
+  _tapArmed = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write consecutive registers. Read-only registers are ignored.
+    @param  reg
+            Address of the first register
+    @param  buffer
+            Register values
+    @param  len
+            Number of registers
+*/
+/**************************************************************************/
+void MSA300Sim::write(uint8_t reg, const uint8_t *buffer, uint8_t len)
+{
+  _writes++;
+  _writeBytes += len;
+
+  for (uint8_t i = 0; i < len; i++, reg++) {
+    if (reg >= MSA300_SIM_REGISTERS || (reg >= MSA300_REG_PARTID && reg <= MSA300_REG_ORIENT_STATUS)) {
+      continue;
+    }
+
+    uint8_t value = buffer[i];
+
+    if (reg == MSA_300_REG_SOFT_RESET) {
+      /* Registers return to their power-on values, time goes on */
+      if ((value & MSA300_SOFT_RESET) == MSA300_SOFT_RESET) {
+        uint32_t time = _time;
+        reset();
+        _time = time;
+      }
+      continue;
+    }
+
+    if (reg == MSA300_REG_INT_LATCH && (value & (1 << 7))) {
+      /* RESET_INT clears every latched interrupt and is not stored */
+      _regs[MSA300_REG_MOTION_INT] = 0;
+      _regs[MSA300_REG_DATA_INT] = 0;
+      value &= ~(1 << 7);
+    }
+
+    _regs[reg] = value;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read consecutive registers
+    @param  reg
+            Address of the first register
+    @param  buffer
+            Destination for the register values
+    @param  len
+            Number of registers
+*/
+/**************************************************************************/
+void MSA300Sim::read(uint8_t reg, uint8_t *buffer, uint8_t len)
+{
+  _reads++;
+  _readBytes += len;
+
+  for (uint8_t i = 0; i < len; i++, reg++) {
+    buffer[i] = (reg < MSA300_SIM_REGISTERS) ? _regs[reg] : 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reset the bus traffic counters
+*/
+/**************************************************************************/
+void MSA300Sim::resetCounters(void)
+{
+  _reads = 0;
+  _writes = 0;
+  _readBytes = 0;
+  _writeBytes = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of bus transactions since resetCounters()
+    @return Number of read and write transactions
+*/
+/**************************************************************************/
+uint32_t MSA300Sim::transactions(void)
+{
+  return _reads + _writes;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the bytes the traffic since resetCounters() takes on the
+            wire, including addressing overhead.
+            I2C write: address, register, data.
+            I2C read: address, register, repeated start address, data.
+            SPI: register, data.
+    @param  i2c
+            True for I2C framing, false for SPI framing
+    @return Number of bytes on the bus
+*/
+/**************************************************************************/
+uint32_t MSA300Sim::busBytes(bool i2c)
+{
+  uint32_t overhead = i2c ? 2 * _writes + 3 * _reads : _writes + _reads;
+
+  return _readBytes + _writeBytes + overhead;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get a register value without going through the bus
+    @param  reg
+            Register address
+    @return Register value
+*/
+/**************************************************************************/
+uint8_t MSA300Sim::peekRegister(uint8_t reg)
+{
+  return (reg < MSA300_SIM_REGISTERS) ? _regs[reg] : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the simulated time
+    @return Microseconds since reset, advanced by one sample period per feed()
+*/
+/**************************************************************************/
+uint32_t MSA300Sim::time(void)
+{
+  return _time;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the sample period of the configured output data rate
+    @return Period in microseconds
+*/
+/**************************************************************************/
+uint32_t MSA300Sim::samplePeriod(void)
+{
+  return (uint32_t)(1000000.0f / dataRateToHz((dataRate_t)(_regs[MSA300_REG_ODR] & 0x0F)));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the scale of a raw register word in the configured range
+    @return mg per raw lsb
+*/
+/**************************************************************************/
+float MSA300Sim::mgPerLsb(void)
+{
+  return (2000 << (_regs[MSA300_REG_RES_RANGE] & 0x3)) / 32768.0f;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Raise an interrupt status bit
+    @param  bit
+            Status bit
+*/
+/**************************************************************************/
+void MSA300Sim::raise(uint8_t bit)
+{
+  _pending |= (1 << bit);
+  _raisedAt[bit] = _time;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Apply the latch mode to the status registers. Non latched bits
+            only stay up for the sample that raised them.
+*/
+/**************************************************************************/
+void MSA300Sim::updateLatch(void)
+{
+  uint32_t duration = latchDuration[_regs[MSA300_REG_INT_LATCH] & 0x0F];
+  uint8_t status = (_regs[MSA300_REG_MOTION_INT] & 0x7F) | ((_regs[MSA300_REG_DATA_INT] & 1) << 7);
+
+  for (uint8_t bit = 0; bit < 8; bit++) {
+    if ((status & (1 << bit)) && duration != UINT32_MAX && _time - _raisedAt[bit] >= duration) {
+      status &= ~(1 << bit);
+    }
+  }
+
+  status |= _pending;
+  _pending = 0;
+
+  _regs[MSA300_REG_MOTION_INT] = status & 0x7F;
+  _regs[MSA300_REG_DATA_INT] = (status >> 7) & 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Active engine: slope above threshold on an enabled axis for
+            ACTIVE_DUR + 1 consecutive samples.
+    @param  slope
+            Per axis slope in mg
+    @param  acc
+            Per axis acceleration in mg
+*/
+/**************************************************************************/
+void MSA300Sim::runActive(const float *slope, const float *acc)
+{
+  uint8_t enabled = _regs[MSA300_REG_INT_SET_0] & 0x7;
+  float lsb = 3.91f * (1 << (_regs[MSA300_REG_RES_RANGE] & 0x3));
+  float threshold = _regs[MSA300_REG_ACTIVE_TH] * lsb;
+  int8_t first = -1;
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    if ((enabled & (1 << axis)) && slope[axis] > threshold) {
+      first = axis;
+      break;
+    }
+  }
+
+  if (first < 0) {
+    _activeCount = 0;
+    return;
+  }
+
+  if (++_activeCount == (_regs[MSA300_REG_ACTIVE_DUR] & 0x3) + 1) {
+    uint8_t status = _regs[MSA300_REG_TAP_ACTIVE_STATUS] & 0xF0;
+    status |= (acc[first] < _prev[first]) << 3;
+    status |= 1 << (2 - first);
+    _regs[MSA300_REG_TAP_ACTIVE_STATUS] = status;
+    raise(STATUS_ACTIVE);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tap engine: a slope above threshold starts a shock. Crossings
+            inside the shock duration are ignored, after it the slope must
+            stay below threshold for the quiet duration to make a tap. A second
+            tap inside the TAP_DUR window is a double tap.
+    @param  slope
+            Per axis slope in mg
+*/
+/**************************************************************************/
+void MSA300Sim::runTap(const float *slope)
+{
+  uint8_t dur = _regs[MSA300_REG_TAP_DUR];
+  uint32_t shock = (dur & (1 << 6)) ? 70000 : 50000;
+  uint32_t quiet = (dur & (1 << 7)) ? 20000 : 30000;
+  float threshold = (_regs[MSA300_REG_TAP_TH] & 0x1F) * 62.5f * (1 << (_regs[MSA300_REG_RES_RANGE] & 0x3));
+  int8_t first = -1;
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    if (slope[axis] > threshold) {
+      first = axis;
+      break;
+    }
+  }
+
+  if (_tapArmed && _time - _firstTapAt > tapWindow[dur & 0x7]) {
+    _tapArmed = false;
+  }
+
+  switch(_tapState) {
+    case TAP_IDLE:
+      if (first >= 0 && threshold > 0) {
+        _tapStart = _time;
+        _tapState = TAP_SHOCK;
+        uint8_t status = _regs[MSA300_REG_TAP_ACTIVE_STATUS] & 0x0F;
+        status |= (uint8_t)(1 << (6 - first));
+        _regs[MSA300_REG_TAP_ACTIVE_STATUS] = status;
+      }
+      break;
+
+    case TAP_SHOCK:
+      /* Crossings inside the shock window belong to the same tap */
+      if (_time - _tapStart >= shock) {
+        _tapStart = _time;
+        _tapState = TAP_QUIET;
+      }
+      break;
+
+    case TAP_QUIET:
+      if (first >= 0) {
+        _tapState = TAP_IDLE;
+      } else if (_time - _tapStart >= quiet) {
+        _tapState = TAP_IDLE;
+        if (_tapArmed) {
+          _tapArmed = false;
+          if (_regs[MSA300_REG_INT_SET_0] & (1 << 4)) {
+            raise(STATUS_DOUBLE_TAP);
+          }
+        } else {
+          _tapArmed = true;
+          _firstTapAt = _time;
+          if (_regs[MSA300_REG_INT_SET_0] & (1 << 5)) {
+            raise(STATUS_SINGLE_TAP);
+          }
+        }
+      }
+      break;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Freefall engine: acceleration below threshold for the freefall
+            duration. Single mode checks every axis, sum mode checks
+            |x| + |y| + |z|.
+    @param  acc
+            Per axis acceleration in mg
+*/
+/**************************************************************************/
+void MSA300Sim::runFreefall(const float *acc)
+{
+  float threshold = _regs[MSA300_REG_FREEFALL_TH] * 7.81f;
+  float hysteresis = (_regs[MSA300_REG_FREEFALL_HY] & 0x3) * 125.0f;
+  uint32_t duration = (_regs[MSA300_REG_FREEFALL_DUR] + 1) * 2000UL;
+  bool low;
+
+  if (_freefall) {
+    /* Leaving freefall needs the hysteresis on top of the threshold */
+    threshold += hysteresis;
+  }
+
+  if (_regs[MSA300_REG_FREEFALL_HY] & (1 << 2)) {
+    low = fabsf(acc[0]) + fabsf(acc[1]) + fabsf(acc[2]) < threshold;
+  } else {
+    low = fabsf(acc[0]) < threshold && fabsf(acc[1]) < threshold && fabsf(acc[2]) < threshold;
+  }
+
+  if (!low) {
+    _freefall = false;
+    return;
+  }
+
+  if (!_freefall) {
+    _freefall = true;
+    _freefallStart = _time;
+  }
+
+  if (_time - _freefallStart >= duration && (_regs[MSA300_REG_INT_SET_1] & (1 << 3))) {
+    raise(STATUS_FREEFALL);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Orientation engine: raise an interrupt when the z or xy
+            orientation derived from gravity changes.
+    @param  acc
+            Per axis acceleration in mg
+*/
+/**************************************************************************/
+void MSA300Sim::runOrientation(const float *acc)
+{
+  uint8_t orient = (acc[2] < 0) << 6;
+
+  if (fabsf(acc[1]) >= fabsf(acc[0])) {
+    orient |= ((acc[1] < 0) ? ORIENT_PORTRAIT_UPSIDEDOWN : ORIENT_PORTRAIT_UPRIGHT) << 4;
+  } else {
+    orient |= ((acc[0] < 0) ? ORIENT_LANDSCAPE_RIGHT : ORIENT_LANDSCAPE_LEFT) << 4;
+  }
+
+  if (orient != _regs[MSA300_REG_ORIENT_STATUS]) {
+    _regs[MSA300_REG_ORIENT_STATUS] = orient;
+    if (_hasPrev && (_regs[MSA300_REG_INT_SET_0] & (1 << 6))) {
+      raise(STATUS_ORIENT);
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Advance the simulation by one sample period. Ignored while the
+            simulated chip is suspended.
+    @param  sample
+            Raw sample measured in the configured range
+*/
+/**************************************************************************/
+void MSA300Sim::feed(const rawAcc_t *sample)
+{
+  if (((_regs[MSA300_REG_PWR_MODE_BW] >> 6) & 0x3) == MSA300_MODE_SUSPEND) {
+    return;
+  }
+
+  _time += samplePeriod();
+
+  /* Offset compensation is subtracted before anything sees the sample */
+  int16_t values[3];
+  float scale = mgPerLsb();
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    float offset = _regs[MSA300_REG_OFFSET_COMP_X + axis] * MSA300_OFFSET_MG_PER_LSB / scale;
+    values[axis] = (int16_t)clamp<float>((&sample->x)[axis] - offset, INT16_MIN, INT16_MAX);
+  }
+
+  /* Data registers hold the sample truncated to the configured resolution */
+  uint16_t mask = (uint16_t)(0xFFFF << (16 - resolutionBits((res_t)((_regs[MSA300_REG_RES_RANGE] >> 2) & 0x3))));
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    uint16_t value = (uint16_t)values[axis] & mask;
+    _regs[MSA300_REG_ACC_X_LSB + 2 * axis] = (uint8_t)value;
+    _regs[MSA300_REG_ACC_X_LSB + 2 * axis + 1] = (uint8_t)(value >> 8);
+  }
+
+  float acc[3];
+  float slope[3];
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    acc[axis] = values[axis] * scale;
+    slope[axis] = _hasPrev ? fabsf(acc[axis] - _prev[axis]) : 0;
+  }
+
+  runActive(slope, acc);
+  runTap(slope);
+  runFreefall(acc);
+  runOrientation(acc);
+
+  if (_regs[MSA300_REG_INT_SET_1] & (1 << 4)) {
+    raise(STATUS_NEW_DATA);
+  }
+
+  updateLatch();
+
+  _prev[0] = acc[0];
+  _prev[1] = acc[1];
+  _prev[2] = acc[2];
+  _hasPrev = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the state of the INT1 line
+    @return True if a mapped interrupt is raised
+*/
+/**************************************************************************/
+bool MSA300Sim::int1(void)
+{
+  return (_regs[MSA300_REG_MOTION_INT] & _regs[MSA300_REG_INT_MAP_0]) ||
+         ((_regs[MSA300_REG_DATA_INT] & 1) && (_regs[MSA300_REG_INT_MAP_1] & (1 << 0)));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the state of the INT2 line
+    @return True if a mapped interrupt is raised
+*/
+/**************************************************************************/
+bool MSA300Sim::int2(void)
+{
+  return (_regs[MSA300_REG_MOTION_INT] & _regs[MSA300_REG_INT_MAP_2_1]) ||
+         ((_regs[MSA300_REG_DATA_INT] & 1) && (_regs[MSA300_REG_INT_MAP_1] & (1 << 7)));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new simulated DMA port
+    @param  sim
+            Simulated chip
+    @param  interrupt
+            INT line that triggers transfers, 1 or 2
+*/
+/**************************************************************************/
+MSA300SimDma::MSA300SimDma(MSA300Sim &sim, uint8_t interrupt)
+{
+  _sim = &sim;
+  _interrupt = interrupt;
+  _running = false;
+  _wakeups = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start circular triggered transfers
+    @param  reg
+            First register of each burst
+    @param  buffer
+            Destination of size * transfers bytes
+    @param  size
+            Bytes per transfer (1 to 255)
+    @param  transfers
+            Number of slots in the buffer
+    @param  blockTransfers
+            Call the handler after every blockTransfers transfers
+    @param  handler
+            Block handler
+    @param  context
+            Passed to the handler
+    @return False if a parameter is out of range
+*/
+/**************************************************************************/
+bool MSA300SimDma::start(uint8_t reg, uint8_t *buffer, uint16_t size, uint16_t transfers,
+                         uint16_t blockTransfers, dmaHandler_t handler, void *context)
+{
+  if (size == 0 || size > 255 || transfers == 0 || blockTransfers == 0) {
+    return false;
+  }
+
+  _reg = reg;
+  _buffer = buffer;
+  _size = size;
+  _transfers = transfers;
+  _blockTransfers = blockTransfers;
+  _handler = handler;
+  _context = context;
+  _slot = 0;
+  _inBlock = 0;
+  _lastTime = _sim->time();
+  _wakeups = 0;
+  _running = true;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stop the transfers
+*/
+/**************************************************************************/
+void MSA300SimDma::stop(void)
+{
+  _running = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Run one transfer if a new sample raised the trigger line, and
+            the block handler if that completed a block
+*/
+/**************************************************************************/
+void MSA300SimDma::service(void)
+{
+  if (!_running || _sim->time() == _lastTime) {
+    return;
+  }
+  _lastTime = _sim->time();
+
+  if (!(_interrupt == 2 ? _sim->int2() : _sim->int1())) {
+    return;
+  }
+
+  _sim->read(_reg, &_buffer[(uint32_t)_slot * _size], (uint8_t)_size);
+  _slot = (_slot + 1 == _transfers) ? 0 : _slot + 1;
+
+  if (++_inBlock == _blockTransfers) {
+    _inBlock = 0;
+    _wakeups++;
+    if (_handler) {
+      _handler(_context);
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of block handler calls since start()
+    @return Number of CPU wakeups
+*/
+/**************************************************************************/
+uint32_t MSA300SimDma::wakeups(void)
+{
+  return _wakeups;
+}
@@ -0,0 +1,112 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Sim.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Simulated MSA300 register map.
+
+    The simulator is an MSA300Bus, so the unmodified driver runs on top of
+    it. Samples are fed one output data period at a time and drive the
+    offset compensation, the data registers, the motion engines (active, tap, freefall,
+    orientation), the status registers, latching and the INT1/INT2 lines.
+    The engines follow the register semantics used by the driver, they are
+    not a bit exact model of the silicon.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_SIM_H
+#define MSA300_SIM_H
+
+#include "MSA300.h"
+#include "MSA300Capture.h"
+
+/*=========================================================================
+    SIMULATOR
+    -----------------------------------------------------------------------*/
+    #define MSA300_SIM_REGISTERS            (0x40)    ///< Size of the simulated register map
+/*=========================================================================*/
+
+/** Class for a simulated MSA300 */
+class MSA300Sim : public MSA300Bus{
+ public:
+  MSA300Sim(void);
+
+  void        reset(void);
+  void        resetEngines(void);
+  void        write(uint8_t reg, const uint8_t *buffer, uint8_t len);
+  void        read(uint8_t reg, uint8_t *buffer, uint8_t len);
+
+  void        feed(const rawAcc_t *sample);
+  bool        int1(void);
+  bool        int2(void);
+  uint32_t    time(void);
+  uint32_t    samplePeriod(void);
+  uint8_t     peekRegister(uint8_t reg);
+
+  void        resetCounters(void);
+  uint32_t    transactions(void);
+  uint32_t    busBytes(bool i2c);
+
+ private:
+  float       mgPerLsb(void);
+  void        raise(uint8_t bit);
+  void        updateLatch(void);
+  void        runActive(const float *slope, const float *acc);
+  void        runTap(const float *slope);
+  void        runFreefall(const float *acc);
+  void        runOrientation(const float *acc);
+
+  uint8_t  _regs[MSA300_SIM_REGISTERS];
+  uint32_t _reads, _writes;
+  uint32_t _readBytes, _writeBytes;
+  uint32_t _time;
+  uint32_t _raisedAt[8];
+  uint8_t  _pending;
+  float    _prev[3];
+  bool     _hasPrev;
+
+  uint8_t  _activeCount;
+  uint32_t _freefallStart;
+  bool     _freefall;
+  uint8_t  _tapState;
+  uint32_t _tapStart;
+  uint32_t _firstTapAt;
+  bool     _tapArmed;
+};
+
+/** Class for a simulated DMA port. Call service() after every MSA300Sim::feed(),
+    each new sample on the trigger line is one transfer. */
+class MSA300SimDma : public MSA300DmaPort{
+ public:
+  MSA300SimDma(MSA300Sim &sim, uint8_t interrupt = 1);
+
+  bool        start(uint8_t reg, uint8_t *buffer, uint16_t size, uint16_t transfers,
+                    uint16_t blockTransfers, dmaHandler_t handler, void *context);
+  void        stop(void);
+  void        service(void);
+  uint32_t    wakeups(void);
+
+ private:
+  MSA300Sim  *_sim;
+  uint8_t     _interrupt;
+  bool        _running;
+  uint8_t     _reg;
+  uint8_t    *_buffer;
+  uint16_t    _size;
+  uint16_t    _transfers;
+  uint16_t    _blockTransfers;
+  uint16_t    _slot;
+  uint16_t    _inBlock;
+  dmaHandler_t _handler;
+  void       *_context;
+  uint32_t    _lastTime;
+  uint32_t    _wakeups;
+};
+
+#endif // MSA300_SIM_H
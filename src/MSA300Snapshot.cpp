@@ -0,0 +1,252 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Snapshot.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Pre-trigger capture of raw samples
+*/
+/**************************************************************************/
+#include "MSA300Snapshot.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new pre-trigger capture
+    @param  storage
+            Array of at least buffers * (pre + post) samples
+    @param  pre
+            Samples kept from before the trigger
+    @param  post
+            Samples recorded after the trigger, at least 1
+    @param  buffers
+            Number of buffers in the pool (2 to MSA300_SNAPSHOT_MAX_BUFFERS).
+            One is always recording, the rest can be held as snapshots.
+*/
+/**************************************************************************/
+MSA300Snapshot::MSA300Snapshot(rawAcc_t *storage, uint16_t pre, uint16_t post, uint8_t buffers)
+{
+  _storage = storage;
+  _post = clamp<uint16_t>(post, 1, 65535);
+  _pre = clamp<uint16_t>(pre, 0, 65535 - _post);
+  _capacity = _pre + _post;
+  _buffers = clamp<uint8_t>(buffers, 2, MSA300_SNAPSHOT_MAX_BUFFERS);
+  _events = 0;
+  _threshold2 = 0;
+
+  _active = 0;
+  _head = 0;
+  _fill = 0;
+  _remaining = 0;
+  _triggered = false;
+  _tail = 0;
+  _completed = 0;
+  _released = 0;
+  _dropped = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Select the on-chip interrupts that trigger a snapshot
+    @param  events
+            Mask of (1 << event_t) values, e.g.
+            (1 << MSA300_EVENT_ACTIVE) | (1 << MSA300_EVENT_FREEFALL)
+*/
+/**************************************************************************/
+void MSA300Snapshot::setTriggers(uint8_t events)
+{
+  _events = events;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the software trigger on the sample magnitude
+    @param  value
+            Threshold in mg, 0 disables the software trigger
+    @param  range
+            Range the samples are measured in
+*/
+/**************************************************************************/
+void MSA300Snapshot::setThreshold(float value, range_t range)
+{
+  float threshold = value / ((float)(2000 << range) / 32768.0f);
+
+  _threshold2 = (uint32_t)clamp<float>(threshold * threshold, 0, 4294967295.0f);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Trigger on an interrupt status, e.g. from checkInterrupts().
+            Ignored while a trigger is already being recorded.
+    @param  interrupts
+            Interrupt status
+    @return True if a selected interrupt started a snapshot
+*/
+/**************************************************************************/
+bool MSA300Snapshot::trigger(const interrupt_t &interrupts)
+{
+  uint8_t pending = ((interrupts.motion & 0x75) | ((interrupts.data & 1) << 7)) & _events;
+
+  if (!pending || _triggered) {
+    return false;
+  }
+
+  start(interrupts);
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start recording the post-trigger samples
+    @param  cause
+            Status stored with the snapshot
+*/
+/**************************************************************************/
+void MSA300Snapshot::start(const interrupt_t &cause)
+{
+  _cause = cause;
+  _remaining = _post;
+  _triggered = true;
+
+  /* Pre-trigger history beyond the configured depth is dropped */
+  if (_fill > _pre) {
+    _fill = _pre;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Hand the recording buffer over as a snapshot and continue in
+            the next buffer. Without a free buffer the snapshot is dropped
+            and recording continues in the same buffer.
+*/
+/**************************************************************************/
+void MSA300Snapshot::freeze(void)
+{
+  _triggered = false;
+
+  if (_completed - _released >= (uint32_t)(_buffers - 1)) {
+    _dropped = _dropped + 1;
+    return;
+  }
+
+  snapshot_t *snapshot = &_snapshots[_active];
+  snapshot->samples = &_storage[(uint32_t)_active * _capacity];
+  snapshot->capacity = _capacity;
+  snapshot->start = (_head >= _fill) ? _head - _fill : _head + _capacity - _fill;
+  snapshot->count = _fill;
+  snapshot->pre = _fill - _post;
+  snapshot->cause = _cause;
+
+  _active = (_active + 1 == _buffers) ? 0 : _active + 1;
+  _head = 0;
+  _fill = 0;
+  _completed = _completed + 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Record one sample, and check the software trigger
+    @param  sample
+            Raw sample
+    @return True when a snapshot was completed by this sample
+*/
+/**************************************************************************/
+bool MSA300Snapshot::update(const rawAcc_t *sample)
+{
+  if (!_triggered && _threshold2 != 0) {
+    uint32_t magnitude = (uint32_t)((int32_t)sample->x * sample->x) +
+                         (uint32_t)((int32_t)sample->y * sample->y) +
+                         (uint32_t)((int32_t)sample->z * sample->z);
+    if (magnitude >= _threshold2) {
+      /* The triggering sample is the first post-trigger sample */
+      interrupt_t none = {};
+      start(none);
+    }
+  }
+
+  rawAcc_t *buffer = &_storage[(uint32_t)_active * _capacity];
+  buffer[_head] = *sample;
+  _head = (_head + 1 == _capacity) ? 0 : _head + 1;
+  if (_fill < _capacity) {
+    _fill++;
+  }
+
+  if (!_triggered || --_remaining > 0) {
+    return false;
+  }
+
+  uint32_t completed = _completed;
+  freeze();
+
+  return _completed != completed;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if post-trigger samples are being recorded
+    @return True between a trigger and the completed snapshot
+*/
+/**************************************************************************/
+bool MSA300Snapshot::triggered(void)
+{
+  return _triggered;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of snapshots waiting to be released
+    @return Number of snapshots
+*/
+/**************************************************************************/
+uint8_t MSA300Snapshot::available(void)
+{
+  return _completed - _released;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the oldest snapshot. It stays valid until release().
+    @return Snapshot, or NULL if there is none
+*/
+/**************************************************************************/
+const snapshot_t *MSA300Snapshot::snapshot(void)
+{
+  if (available() == 0) {
+    return NULL;
+  }
+
+  return &_snapshots[_tail];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Return the buffer of the oldest snapshot to the pool
+*/
+/**************************************************************************/
+void MSA300Snapshot::release(void)
+{
+  if (available() == 0) {
+    return;
+  }
+
+  _tail = (_tail + 1 == _buffers) ? 0 : _tail + 1;
+  _released = _released + 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the number of snapshots dropped because every buffer was
+            held
+    @return Number of dropped snapshots
+*/
+/**************************************************************************/
+uint32_t MSA300Snapshot::dropped(void)
+{
+  return _dropped;
+}
@@ -0,0 +1,95 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Snapshot.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Pre-trigger capture of raw samples.
+
+    Samples are recorded continuously into a circular buffer. A trigger,
+    either an on-chip interrupt or a software magnitude threshold, keeps
+    the pre-trigger samples and records the post-trigger samples. The
+    buffer is then handed over as a snapshot without copying, and
+    recording continues in the next free buffer of the pool.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_SNAPSHOT_H
+#define MSA300_SNAPSHOT_H
+
+#include "MSA300.h"
+#include "MSA300Dispatch.h"
+
+/*=========================================================================
+    SNAPSHOT
+    -----------------------------------------------------------------------*/
+    #define MSA300_SNAPSHOT_MAX_BUFFERS     (8)       ///< Maximum number of buffers in the pool
+/*=========================================================================*/
+
+/** Frozen capture. The samples stay in their circular buffer, oldest first from start. */
+typedef struct snapshot_t
+{
+  const rawAcc_t *samples;      ///< Buffer the snapshot was recorded in
+  uint16_t capacity;            ///< Size of the buffer
+  uint16_t start;               ///< Index of the oldest sample
+  uint16_t count;               ///< Number of samples
+  uint16_t pre;                 ///< Number of samples before the trigger
+  interrupt_t cause;            ///< Status that triggered, all zero for the software threshold
+
+  /** Get a sample counted from the oldest */
+  const rawAcc_t &at(uint16_t index) const {
+    uint32_t position = (uint32_t)start + index;
+    return samples[position >= capacity ? position - capacity : position];
+  }
+} snapshot_t;
+
+/** Class for pre-trigger capture. Storage is supplied by the caller and holds
+    buffers * (pre + post) samples. update() and trigger() are the producer
+    side (may run in an ISR), snapshot() and release() the consumer side. */
+class MSA300Snapshot{
+ public:
+  MSA300Snapshot(rawAcc_t *storage, uint16_t pre, uint16_t post, uint8_t buffers);
+
+  void        setTriggers(uint8_t events);
+  void        setThreshold(float value, range_t range);
+  bool        trigger(const interrupt_t &interrupts);
+  bool        update(const rawAcc_t *sample);
+  bool        triggered(void);
+
+  uint8_t     available(void);
+  const snapshot_t *snapshot(void);
+  void        release(void);
+  uint32_t    dropped(void);
+
+ private:
+  void        start(const interrupt_t &cause);
+  void        freeze(void);
+
+  rawAcc_t   *_storage;
+  uint16_t    _pre;
+  uint16_t    _post;
+  uint16_t    _capacity;
+  uint8_t     _buffers;
+  uint8_t     _events;
+  uint32_t    _threshold2;
+
+  snapshot_t  _snapshots[MSA300_SNAPSHOT_MAX_BUFFERS];
+  uint8_t     _active;
+  uint16_t    _head;
+  uint16_t    _fill;
+  uint16_t    _remaining;
+  bool        _triggered;
+  interrupt_t _cause;
+
+  uint8_t     _tail;
+  volatile uint32_t _completed;
+  volatile uint32_t _released;
+  volatile uint32_t _dropped;
+};
+
+#endif // MSA300_SNAPSHOT_H
@@ -0,0 +1,533 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Spectrum.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Fixed-point vibration spectrum of raw MSA300 sample blocks
+*/
+/**************************************************************************/
+#include "MSA300Spectrum.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MSA300_SPECTRUM_SSE2
+#define MSA300_SPECTRUM_LANES 8
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MSA300_SPECTRUM_NEON
+#define MSA300_SPECTRUM_LANES 4
+#endif
+
+/* Hardware float makes sqrtf() cheaper than the integer square root */
+#if defined(__SSE2__) || defined(__ARM_FP)
+#define MSA300_SPECTRUM_FPU
+#endif
+
+/** Quarter wave of sin() in Q15, 1024 steps per cycle */
+static const int16_t quarterSine[257] = {
+  0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+  2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+  4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+  7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+  9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+  11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+  14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+  16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+  18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+  20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+  22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+  23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+  25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+  26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+  28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+  29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+  30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+  31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+  31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+  32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+  32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+  32757, 32761, 32765, 32766, 32767
+};
+
+/**************************************************************************/
+/*!
+    @brief  Get sin() of a table angle
+    @param  index
+            Angle in 1/1024 of a cycle
+    @return Sine in Q15
+*/
+/**************************************************************************/
+static inline int16_t sinQ15(uint16_t index)
+{
+  uint16_t step = index & 0xFF;
+
+  switch ((index >> 8) & 0x3) {
+    case 0:
+      return quarterSine[step];
+    case 1:
+      return quarterSine[256 - step];
+    case 2:
+      return -quarterSine[step];
+    default:
+      return -quarterSine[256 - step];
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get cos() of a table angle
+    @param  index
+            Angle in 1/1024 of a cycle
+    @return Cosine in Q15
+*/
+/**************************************************************************/
+static inline int16_t cosQ15(uint16_t index)
+{
+  return sinQ15(index + 256);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new spectrum engine
+    @param  workspace
+            Array of MSA300_SPECTRUM_WORKSPACE(size) words for the largest
+            block size that will be used
+    @param  capacity
+            Number of words in the workspace
+*/
+/**************************************************************************/
+MSA300Spectrum::MSA300Spectrum(int16_t *workspace, uint16_t capacity)
+{
+  _workspace = workspace;
+  _capacity = capacity;
+  _size = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the block size and the sampling parameters
+    @param  size
+            Samples per block, a power of two from 64 to 1024
+    @param  sampleRate
+            Output data rate of the samples in Hz
+    @param  range
+            Range the samples are measured in
+    @return False if the size is not supported or the workspace is too small
+*/
+/**************************************************************************/
+bool MSA300Spectrum::begin(uint16_t size, float sampleRate, range_t range)
+{
+  if (size < MSA300_FFT_MIN_SIZE || size > MSA300_FFT_MAX_SIZE || (size & (size - 1)) ||
+      MSA300_SPECTRUM_WORKSPACE(size) > _capacity) {
+    _size = 0;
+    return false;
+  }
+
+  _size = size;
+  _sampleRate = sampleRate;
+  _mgPerLsb = (float)(2000 << range) / 32768.0f;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the block size
+    @return Samples per block, 0 before a successful begin()
+*/
+/**************************************************************************/
+uint16_t MSA300Spectrum::getSize(void)
+{
+  return _size;
+}
+
+/**************************************************************************/
+/*!
+    @brief  In place radix-2 complex FFT of bit reversed input. A stage
+            is scaled down by 2 only when its input could overflow.
+    @param  re
+            Real parts
+    @param  im
+            Imaginary parts
+    @param  max
+            Largest absolute input value
+    @return Number of scaled stages
+*/
+/**************************************************************************/
+uint8_t MSA300Spectrum::transform(int16_t *re, int16_t *im, int32_t max)
+{
+  uint16_t half = _size / 2;
+  uint8_t exponent = 0;
+
+  for (uint16_t h = 1; h < half; h <<= 1) {
+    /* Output range of this stage, decides the scaling of the next one */
+    int16_t high = 0;
+    int16_t low = 0;
+
+    /* The twiddled half grows up to sqrt(2), so 13500 keeps the sum below
+       32767. Scaling halves both operands before the sum, so 16-bit lanes
+       cannot overflow either. */
+    uint8_t scale = (max > 13500) ? 1 : 0;
+    exponent += scale;
+
+    /* Twiddle W(2h, j) is table angle j * 512 / h */
+    uint16_t step = (MSA300_FFT_MAX_SIZE / 2) / h;
+
+#if defined(MSA300_SPECTRUM_LANES)
+    if (h >= MSA300_SPECTRUM_LANES) {
+      for (uint16_t j0 = 0; j0 < h; j0 += MSA300_SPECTRUM_LANES) {
+#if defined(MSA300_SPECTRUM_SSE2)
+        int16_t cs[16], sc[16];
+        for (uint8_t l = 0; l < 8; l++) {
+          int16_t c = cosQ15((j0 + l) * step);
+          int16_t s = sinQ15((j0 + l) * step);
+          cs[2 * l] = c;
+          cs[2 * l + 1] = s;
+          sc[2 * l] = -s;
+          sc[2 * l + 1] = c;
+        }
+        __m128i csLo = _mm_loadu_si128((const __m128i *)&cs[0]);
+        __m128i csHi = _mm_loadu_si128((const __m128i *)&cs[8]);
+        __m128i scLo = _mm_loadu_si128((const __m128i *)&sc[0]);
+        __m128i scHi = _mm_loadu_si128((const __m128i *)&sc[8]);
+        __m128i shift = _mm_cvtsi32_si128(scale);
+        __m128i product = _mm_cvtsi32_si128(15 + scale);
+        __m128i highs = _mm_setzero_si128();
+        __m128i lows = _mm_setzero_si128();
+
+        for (uint16_t p = j0; p < half; p += 2 * h) {
+          uint16_t q = p + h;
+          __m128i br = _mm_loadu_si128((const __m128i *)&re[q]);
+          __m128i bi = _mm_loadu_si128((const __m128i *)&im[q]);
+          __m128i lo = _mm_unpacklo_epi16(br, bi);
+          __m128i hi = _mm_unpackhi_epi16(br, bi);
+
+          /* (br + i bi)(c - i s) as pairwise multiply-adds */
+          __m128i tr = _mm_packs_epi32(_mm_sra_epi32(_mm_madd_epi16(lo, csLo), product),
+                                       _mm_sra_epi32(_mm_madd_epi16(hi, csHi), product));
+          __m128i ti = _mm_packs_epi32(_mm_sra_epi32(_mm_madd_epi16(lo, scLo), product),
+                                       _mm_sra_epi32(_mm_madd_epi16(hi, scHi), product));
+          __m128i ar = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&re[p]), shift);
+          __m128i ai = _mm_sra_epi16(_mm_loadu_si128((const __m128i *)&im[p]), shift);
+
+          __m128i pr = _mm_add_epi16(ar, tr);
+          __m128i pi = _mm_add_epi16(ai, ti);
+          __m128i qr = _mm_sub_epi16(ar, tr);
+          __m128i qi = _mm_sub_epi16(ai, ti);
+
+          _mm_storeu_si128((__m128i *)&re[p], pr);
+          _mm_storeu_si128((__m128i *)&im[p], pi);
+          _mm_storeu_si128((__m128i *)&re[q], qr);
+          _mm_storeu_si128((__m128i *)&im[q], qi);
+
+          highs = _mm_max_epi16(highs, _mm_max_epi16(_mm_max_epi16(pr, pi), _mm_max_epi16(qr, qi)));
+          lows = _mm_min_epi16(lows, _mm_min_epi16(_mm_min_epi16(pr, pi), _mm_min_epi16(qr, qi)));
+        }
+
+        int16_t lanes[16];
+        _mm_storeu_si128((__m128i *)&lanes[0], highs);
+        _mm_storeu_si128((__m128i *)&lanes[8], lows);
+        for (uint8_t l = 0; l < 8; l++) {
+          high = lanes[l] > high ? lanes[l] : high;
+          low = lanes[8 + l] < low ? lanes[8 + l] : low;
+        }
+#elif defined(MSA300_SPECTRUM_NEON)
+        int16_t c[4], s[4];
+        for (uint8_t l = 0; l < 4; l++) {
+          c[l] = cosQ15((j0 + l) * step);
+          s[l] = sinQ15((j0 + l) * step);
+        }
+        int16x4_t cv = vld1_s16(c);
+        int16x4_t sv = vld1_s16(s);
+        int16x4_t shift = vdup_n_s16(-(int16_t)scale);
+        int32x4_t product = vdupq_n_s32(-(int32_t)(15 + scale));
+        int16x4_t highs = vdup_n_s16(0);
+        int16x4_t lows = vdup_n_s16(0);
+
+        for (uint16_t p = j0; p < half; p += 2 * h) {
+          uint16_t q = p + h;
+          int16x4_t br = vld1_s16(&re[q]);
+          int16x4_t bi = vld1_s16(&im[q]);
+          int16x4_t tr = vmovn_s32(vshlq_s32(vmlal_s16(vmull_s16(br, cv), bi, sv), product));
+          int16x4_t ti = vmovn_s32(vshlq_s32(vmlsl_s16(vmull_s16(bi, cv), br, sv), product));
+          int16x4_t ar = vshl_s16(vld1_s16(&re[p]), shift);
+          int16x4_t ai = vshl_s16(vld1_s16(&im[p]), shift);
+
+          int16x4_t pr = vadd_s16(ar, tr);
+          int16x4_t pi = vadd_s16(ai, ti);
+          int16x4_t qr = vsub_s16(ar, tr);
+          int16x4_t qi = vsub_s16(ai, ti);
+
+          vst1_s16(&re[p], pr);
+          vst1_s16(&im[p], pi);
+          vst1_s16(&re[q], qr);
+          vst1_s16(&im[q], qi);
+
+          highs = vmax_s16(highs, vmax_s16(vmax_s16(pr, pi), vmax_s16(qr, qi)));
+          lows = vmin_s16(lows, vmin_s16(vmin_s16(pr, pi), vmin_s16(qr, qi)));
+        }
+
+        high = vmaxv_s16(highs) > high ? vmaxv_s16(highs) : high;
+        low = vminv_s16(lows) < low ? vminv_s16(lows) : low;
+#endif
+      }
+      max = (high > -low) ? high : -low;
+      continue;
+    }
+#endif
+
+    for (uint16_t j = 0; j < h; j++) {
+      int32_t c = cosQ15(j * step);
+      int32_t s = sinQ15(j * step);
+
+      for (uint16_t p = j; p < half; p += 2 * h) {
+        uint16_t q = p + h;
+        int32_t tr = (re[q] * c + im[q] * s) >> (15 + scale);
+        int32_t ti = (im[q] * c - re[q] * s) >> (15 + scale);
+        int32_t ar = re[p] >> scale;
+        int32_t ai = im[p] >> scale;
+
+        re[p] = ar + tr;
+        im[p] = ai + ti;
+        re[q] = ar - tr;
+        im[q] = ai - ti;
+
+        high = re[p] > high ? re[p] : high;
+        high = im[p] > high ? im[p] : high;
+        high = re[q] > high ? re[q] : high;
+        high = im[q] > high ? im[q] : high;
+        low = re[p] < low ? re[p] : low;
+        low = im[p] < low ? im[p] : low;
+        low = re[q] < low ? re[q] : low;
+        low = im[q] < low ? im[q] : low;
+      }
+    }
+    max = (high > -low) ? high : -low;
+  }
+
+  return exponent;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compute the magnitude spectrum of one axis
+    @param  samples
+            Block of getSize() raw samples
+    @param  axis
+            Axis to be transformed
+    @param  spectrum
+            Spectrum with bins pointing at MSA300_SPECTRUM_BINS(size)
+            entries. The other fields are filled in.
+    @return False if begin() was not successful
+*/
+/**************************************************************************/
+bool MSA300Spectrum::compute(const rawAcc_t *samples, axis_t axis, spectrum_t *spectrum)
+{
+  if (_size == 0) {
+    return false;
+  }
+
+  uint16_t half = _size / 2;
+  int16_t *re = _workspace;
+  int16_t *im = _workspace + half;
+  const int16_t *values = &samples[0].x + axis;
+
+  spectrum->count = half + 1;
+  spectrum->binHz = _sampleRate / _size;
+  spectrum->scale = 0;
+
+  /* Remove gravity and any offset */
+  int32_t sum = 0;
+  for (uint16_t n = 0; n < _size; n++) {
+    sum += values[3 * n];
+  }
+  int32_t mean = sum / _size;
+
+  int32_t peak = 0;
+  for (uint16_t n = 0; n < _size; n++) {
+    int32_t deviation = values[3 * n] - mean;
+    deviation = deviation < 0 ? -deviation : deviation;
+    peak = deviation > peak ? deviation : peak;
+  }
+
+  if (peak == 0) {
+    memset(spectrum->bins, 0, spectrum->count * sizeof(uint16_t));
+    return true;
+  }
+
+  /* Normalize to 14 bits so the window keeps the resolution */
+  int8_t shift = 0;
+  while (peak > 16383) {
+    peak >>= 1;
+    shift--;
+  }
+  while (peak <= 8191) {
+    peak <<= 1;
+    shift++;
+  }
+
+  /* Hann window, even samples to the real and odd to the imaginary part */
+  uint16_t angle = MSA300_FFT_MAX_SIZE / _size;
+  uint16_t index = 0;
+  int32_t windowed = 0;
+  for (uint16_t n = 0; n < _size; n += 2) {
+    int32_t even = values[3 * n] - mean;
+    int32_t odd = values[3 * n + 3] - mean;
+    if (shift >= 0) {
+      even <<= shift;
+      odd <<= shift;
+    } else {
+      even >>= -shift;
+      odd >>= -shift;
+    }
+
+    even = (even * ((32767 - cosQ15(n * angle)) >> 1)) >> 15;
+    odd = (odd * ((32767 - cosQ15((n + 1) * angle)) >> 1)) >> 15;
+    re[index] = (int16_t)even;
+    im[index] = (int16_t)odd;
+    windowed = (even > windowed) ? even : (-even > windowed) ? -even : windowed;
+    windowed = (odd > windowed) ? odd : (-odd > windowed) ? -odd : windowed;
+
+    /* Bit reversed increment */
+    uint16_t bit = half >> 1;
+    while (index & bit) {
+      index ^= bit;
+      bit >>= 1;
+    }
+    index |= bit;
+  }
+
+  uint8_t exponent = transform(re, im, windowed);
+
+  /* Split the half size complex result into the real spectrum, halved once more to fit 16 bits */
+  for (uint16_t k = 0; k <= half; k++) {
+    uint16_t i = (k == half) ? 0 : k;
+    uint16_t m = (k == 0) ? 0 : half - k;
+    int32_t a = re[i], b = im[i];
+    int32_t c = re[m], d = im[m];
+    int32_t cw = cosQ15(k * angle);
+    int32_t sw = sinQ15(k * angle);
+
+    int32_t xr = ((a + c) + (((b + d) * cw) >> 15) + (((c - a) * sw) >> 15)) >> 2;
+    int32_t xi = ((b - d) + (((c - a) * cw) >> 15) - (((b + d) * sw) >> 15)) >> 2;
+
+#if defined(MSA300_SPECTRUM_FPU)
+    uint32_t magnitude = (uint32_t)sqrtf((float)((uint32_t)(xr * xr) + (uint32_t)(xi * xi)));
+#else
+    uint32_t magnitude = squareRoot((uint32_t)(xr * xr) + (uint32_t)(xi * xi));
+#endif
+    spectrum->bins[k] = (magnitude > 65535) ? 65535 : magnitude;
+  }
+
+  /* 4 undoes the window gain and folds the negative frequencies */
+  spectrum->scale = 4.0f * _mgPerLsb * ldexpf(1.0f, exponent + 1 - shift) / _size;
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the RMS acceleration within a frequency band. DC is
+            excluded.
+    @param  spectrum
+            Spectrum from compute()
+    @param  lowHz
+            Lower edge of the band
+    @param  highHz
+            Upper edge of the band
+    @return RMS in mg
+*/
+/**************************************************************************/
+float MSA300Spectrum::bandRms(const spectrum_t *spectrum, float lowHz, float highHz)
+{
+  int32_t first = (int32_t)ceilf(lowHz / spectrum->binHz);
+  int32_t last = (int32_t)floorf(highHz / spectrum->binHz);
+  float sum = 0;
+
+  first = clamp<int32_t>(first, 1, spectrum->count - 1);
+  last = clamp<int32_t>(last, 0, spectrum->count - 1);
+
+  for (int32_t k = first; k <= last; k++) {
+    float bin = spectrum->bins[k];
+    sum += bin * bin;
+  }
+
+  /* A Hann windowed sine spreads 1.5 amplitude^2 over its bins, RMS^2 is amplitude^2 / 2 */
+  return sqrtf(sum / 3.0f) * spectrum->scale;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the RMS acceleration of consecutive bands
+    @param  spectrum
+            Spectrum from compute()
+    @param  edges
+            bands + 1 band edges in Hz, ascending
+    @param  bands
+            Number of bands
+    @param  rms
+            Filled with the RMS of each band in mg
+*/
+/**************************************************************************/
+void MSA300Spectrum::bandsRms(const spectrum_t *spectrum, const float *edges, uint8_t bands, float *rms)
+{
+  for (uint8_t i = 0; i < bands; i++) {
+    /* Bins on an edge go to the upper band */
+    rms[i] = bandRms(spectrum, edges[i], edges[i + 1] - spectrum->binHz * 0.5f);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Find the largest spectral peaks. Frequency and amplitude are
+            interpolated between bins.
+    @param  spectrum
+            Spectrum from compute()
+    @param  peaks
+            Filled with up to count peaks, largest first
+    @param  count
+            Maximum number of peaks
+    @return Number of peaks found
+*/
+/**************************************************************************/
+uint8_t MSA300Spectrum::findPeaks(const spectrum_t *spectrum, peak_t *peaks, uint8_t count)
+{
+  const uint16_t *bins = spectrum->bins;
+  uint8_t found = 0;
+
+  for (uint16_t k = 1; k + 1 < spectrum->count; k++) {
+    if (bins[k] <= bins[k - 1] || bins[k] < bins[k + 1]) {
+      continue;
+    }
+
+    /* Parabola through the peak and its neighbours */
+    float alpha = bins[k - 1];
+    float beta = bins[k];
+    float gamma = bins[k + 1];
+    float delta = 0.5f * (alpha - gamma) / (alpha - 2 * beta + gamma);
+
+    peak_t peak;
+    peak.frequency = (k + delta) * spectrum->binHz;
+    peak.amplitude = (beta - 0.25f * (alpha - gamma) * delta) * spectrum->scale;
+
+    /* Insert sorted by amplitude */
+    uint8_t i = (found < count) ? found++ : count;
+    while (i > 0 && peaks[i - 1].amplitude < peak.amplitude) {
+      if (i < count) {
+        peaks[i] = peaks[i - 1];
+      }
+      i--;
+    }
+    if (i < count) {
+      peaks[i] = peak;
+    }
+  }
+
+  return found;
+}
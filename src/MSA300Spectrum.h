@@ -0,0 +1,77 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Spectrum.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Fixed-point vibration spectrum of raw MSA300 sample blocks.
+
+    One axis of a block of 64 to 1024 raw samples has its mean removed and
+    a Hann window applied. It is then transformed with a 16-bit real FFT
+    (a complex FFT of half the size plus a split step). Every stage of the
+    FFT uses block floating point, so small vibrations on top of gravity
+    keep their precision. The result is a magnitude per bin, with a scale
+    that turns it into the amplitude of a sine at that frequency in mg.
+    Host builds use SSE2 or NEON for the butterflies.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_SPECTRUM_H
+#define MSA300_SPECTRUM_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    SPECTRUM
+    -----------------------------------------------------------------------*/
+    #define MSA300_FFT_MIN_SIZE             (64)      ///< Smallest block size
+    #define MSA300_FFT_MAX_SIZE             (1024)    ///< Largest block size
+    #define MSA300_SPECTRUM_WORKSPACE(n)    (n)       ///< Workspace words for a block of n samples
+    #define MSA300_SPECTRUM_BINS(n)         ((n) / 2 + 1) ///< Magnitude bins for a block of n samples
+/*=========================================================================*/
+
+/** Magnitude spectrum of one axis */
+typedef struct
+{
+  uint16_t *bins;               ///< Magnitude per bin, MSA300_SPECTRUM_BINS(size) entries from DC to Nyquist
+  uint16_t count;               ///< Number of bins
+  float    binHz;               ///< Width of a bin in Hz
+  float    scale;               ///< Sine amplitude in mg per magnitude unit
+} spectrum_t;
+
+/** Spectral peak */
+typedef struct
+{
+  float frequency;              ///< Interpolated frequency in Hz
+  float amplitude;              ///< Interpolated amplitude in mg
+} peak_t;
+
+/** Class for computing vibration spectra. The workspace is supplied by the caller. */
+class MSA300Spectrum{
+ public:
+  MSA300Spectrum(int16_t *workspace, uint16_t capacity);
+
+  bool        begin(uint16_t size, float sampleRate, range_t range);
+  bool        compute(const rawAcc_t *samples, axis_t axis, spectrum_t *spectrum);
+  uint16_t    getSize(void);
+
+  static float   bandRms(const spectrum_t *spectrum, float lowHz, float highHz);
+  static void    bandsRms(const spectrum_t *spectrum, const float *edges, uint8_t bands, float *rms);
+  static uint8_t findPeaks(const spectrum_t *spectrum, peak_t *peaks, uint8_t count);
+
+ private:
+  uint8_t     transform(int16_t *re, int16_t *im, int32_t max);
+
+  int16_t    *_workspace;
+  uint16_t    _capacity;
+  uint16_t    _size;
+  float       _sampleRate;
+  float       _mgPerLsb;
+};
+
+#endif // MSA300_SPECTRUM_H
@@ -0,0 +1,315 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Stats.cpp
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Windowed statistics of raw MSA300 samples
+*/
+/**************************************************************************/
+#include "MSA300Stats.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a new statistics accumulator
+    @param  blocks
+            Storage for the sub-blocks of one window
+    @param  count
+            Number of sub-blocks in the storage
+*/
+/**************************************************************************/
+MSA300Stats::MSA300Stats(statsBlock_t *blocks, uint8_t count)
+{
+  _blocks = blocks;
+  _capacity = count;
+  _blockSamples = 0;
+  _windowBlocks = 0;
+  _hopBlocks = 0;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Configure the window and start over
+    @param  blockSamples
+            Samples per sub-block, 1 to MSA300_STATS_MAX_BLOCK
+    @param  windowBlocks
+            Sub-blocks per window, 1 to the storage size
+    @param  hopBlocks
+            Sub-blocks the window advances by. Equal to windowBlocks for
+            tumbling windows, smaller for sliding windows.
+    @param  range
+            Range the samples are measured in
+    @param  resolution
+            Resolution the samples are measured in
+    @return False if a parameter is out of range
+*/
+/**************************************************************************/
+bool MSA300Stats::begin(uint16_t blockSamples, uint8_t windowBlocks, uint8_t hopBlocks, range_t range, res_t resolution)
+{
+  if (blockSamples == 0 || blockSamples > MSA300_STATS_MAX_BLOCK ||
+      windowBlocks == 0 || windowBlocks > _capacity ||
+      hopBlocks == 0 || hopBlocks > windowBlocks) {
+    _windowBlocks = 0;
+    return false;
+  }
+
+  _blockSamples = blockSamples;
+  _windowBlocks = windowBlocks;
+  _hopBlocks = hopBlocks;
+  _shift = 16 - resolutionBits(resolution);
+  _mgPerLsb = (float)(2000 << range) / (float)(1 << (resolutionBits(resolution) - 1));
+  reset();
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop all accumulated samples
+*/
+/**************************************************************************/
+void MSA300Stats::reset(void)
+{
+  _current = 0;
+  _filled = 0;
+  _sinceWindow = 0;
+  _open = false;
+  _ready = false;
+  _centered = false;
+  memset(&_result, 0, sizeof(_result));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start the current sub-block with its first sample
+    @param  sample
+            First sample of the sub-block
+*/
+/**************************************************************************/
+void MSA300Stats::startBlock(const rawAcc_t *sample)
+{
+  statsBlock_t *block = &_blocks[_current];
+  const int16_t *values = &sample->x;
+
+  memset(block, 0, sizeof(statsBlock_t));
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    int16_t value = values[axis] >> _shift;
+    block->ref[axis] = value;
+    block->min[axis] = value;
+    block->max[axis] = value;
+    if (!_centered) {
+      _center[axis] = value;
+    }
+  }
+
+  _centered = true;
+  _open = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add one sample
+    @param  sample
+            Raw sample
+    @return True if the sample completed a window
+*/
+/**************************************************************************/
+bool MSA300Stats::update(const rawAcc_t *sample)
+{
+  update(sample, 1);
+
+  return _ready;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add a batch of samples. Stops after the sample that completes
+            a window, so that its result can be read before going on.
+    @param  samples
+            Raw samples
+    @param  count
+            Number of samples
+    @return Number of samples used
+*/
+/**************************************************************************/
+uint16_t MSA300Stats::update(const rawAcc_t *samples, uint16_t count)
+{
+  uint16_t used = 0;
+
+  _ready = false;
+  if (_windowBlocks == 0) {
+    return count;
+  }
+
+  while (used < count) {
+    if (!_open) {
+      startBlock(&samples[used]);
+    }
+
+    statsBlock_t *block = &_blocks[_current];
+    uint16_t batch = _blockSamples - block->count;
+    if (batch > count - used) {
+      batch = count - used;
+    }
+
+    for (uint16_t i = 0; i < batch; i++) {
+      const int16_t *values = &samples[used + i].x;
+      uint32_t vector = 0;
+
+      for (uint8_t axis = 0; axis < 3; axis++) {
+        int16_t value = values[axis] >> _shift;
+        int32_t deviation = value - block->ref[axis];
+        int32_t square = deviation * deviation;
+
+        block->sum[axis] += deviation;
+        block->sum2[axis] += square;
+        block->sum3[axis] += (int64_t)square * deviation;
+        block->sum4[axis] += (int64_t)square * square;
+
+        block->min[axis] = (value < block->min[axis]) ? value : block->min[axis];
+        block->max[axis] = (value > block->max[axis]) ? value : block->max[axis];
+
+        int32_t centered = value - _center[axis];
+        vector += centered * centered;
+      }
+
+      block->vectorSum += vector;
+      block->vectorMax = (vector > block->vectorMax) ? vector : block->vectorMax;
+    }
+
+    block->count += batch;
+    used += batch;
+
+    if (block->count < _blockSamples) {
+      continue;
+    }
+
+    /* Sub-block complete, the next one reuses the oldest slot */
+    _open = false;
+    _current = (_current + 1 == _windowBlocks) ? 0 : _current + 1;
+    if (_filled < _windowBlocks) {
+      _filled++;
+    }
+
+    if (++_sinceWindow >= _hopBlocks && _filled == _windowBlocks) {
+      _sinceWindow = 0;
+      finishWindow();
+      break;
+    }
+  }
+
+  return used;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Merge the sub-blocks of the window into the result
+*/
+/**************************************************************************/
+void MSA300Stats::finishWindow(void)
+{
+  float n[3] = {0, 0, 0};
+  float mean[3], m2[3], m3[3], m4[3];
+  int16_t min[3], max[3];
+  float vectorSum = 0;
+  uint32_t vectorMax = 0;
+
+  for (uint8_t b = 0; b < _windowBlocks; b++) {
+    const statsBlock_t *block = &_blocks[b];
+    float nb = block->count;
+
+    for (uint8_t axis = 0; axis < 3; axis++) {
+      /* Central moments of the sub-block from its sums around ref */
+      float mu = block->sum[axis] / nb;
+      float s2 = (float)block->sum2[axis];
+      float s3 = (float)block->sum3[axis];
+      float s4 = (float)block->sum4[axis];
+      float meanB = block->ref[axis] + mu;
+      float m2B = s2 - nb * mu * mu;
+      float m3B = s3 - 3 * mu * s2 + 2 * nb * mu * mu * mu;
+      float m4B = s4 - 4 * mu * s3 + 6 * mu * mu * s2 - 3 * nb * mu * mu * mu * mu;
+
+      if (b == 0) {
+        n[axis] = nb;
+        mean[axis] = meanB;
+        m2[axis] = m2B;
+        m3[axis] = m3B;
+        m4[axis] = m4B;
+        min[axis] = block->min[axis];
+        max[axis] = block->max[axis];
+        continue;
+      }
+
+      /* Pairwise combination of central moments */
+      float na = n[axis];
+      float total = na + nb;
+      float delta = meanB - mean[axis];
+      float delta2 = delta * delta;
+
+      m4[axis] += m4B + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (total * total * total) +
+                  6 * delta2 * (na * na * m2B + nb * nb * m2[axis]) / (total * total) +
+                  4 * delta * (na * m3B - nb * m3[axis]) / total;
+      m3[axis] += m3B + delta2 * delta * na * nb * (na - nb) / (total * total) +
+                  3 * delta * (na * m2B - nb * m2[axis]) / total;
+      m2[axis] += m2B + delta2 * na * nb / total;
+      mean[axis] += delta * nb / total;
+      n[axis] = total;
+      min[axis] = (block->min[axis] < min[axis]) ? block->min[axis] : min[axis];
+      max[axis] = (block->max[axis] > max[axis]) ? block->max[axis] : max[axis];
+    }
+
+    vectorSum += (float)block->vectorSum;
+    vectorMax = (block->vectorMax > vectorMax) ? block->vectorMax : vectorMax;
+  }
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    axisStats_t *stats = &_result.axis[axis];
+    float variance = (m2[axis] > 0) ? m2[axis] / n[axis] : 0;
+    float above = max[axis] - mean[axis];
+    float below = mean[axis] - min[axis];
+
+    stats->mean = mean[axis] * _mgPerLsb;
+    stats->rms = sqrtf(variance) * _mgPerLsb;
+    stats->peak = ((above > below) ? above : below) * _mgPerLsb;
+    stats->peakToPeak = (max[axis] - min[axis]) * _mgPerLsb;
+    stats->crest = (stats->rms > 0) ? stats->peak / stats->rms : 0;
+    stats->kurtosis = (variance > 0) ? m4[axis] / (n[axis] * variance * variance) : 0;
+
+    /* Vector deviations of the next window are taken from this mean */
+    _center[axis] = (int16_t)lrintf(mean[axis]);
+  }
+
+  _result.samples = (uint32_t)n[0];
+  _result.rms = sqrtf(vectorSum / n[0]) * _mgPerLsb;
+  _result.peak = sqrtf((float)vectorMax) * _mgPerLsb;
+  _result.crest = (_result.rms > 0) ? _result.peak / _result.rms : 0;
+  _ready = true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check if the last update completed a window
+    @return True if a new result is available
+*/
+/**************************************************************************/
+bool MSA300Stats::ready(void)
+{
+  return _ready;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Get the statistics of the last completed window
+    @return Statistics, all zero before the first window
+*/
+/**************************************************************************/
+const stats_t *MSA300Stats::result(void)
+{
+  return &_result;
+}
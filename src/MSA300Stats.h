@@ -0,0 +1,106 @@
+/**************************************************************************/
+/*!
+    @file     MSA300Stats.h
+
+    @section author Author
+    Joel Lavikainen
+
+    @section license License
+    BSD-3
+
+    @section intro_sec Introduction
+    Windowed statistics of raw MSA300 samples.
+
+    Samples are accumulated in integer sub-blocks of up to 128 samples.
+    Each sub-block holds sums of the first four powers relative to its
+    first sample, plus the minimum and maximum. A window is a run of
+    consecutive sub-blocks and advances a whole number of sub-blocks at a
+    time. With a hop equal to the window the windows tumble, with a
+    smaller hop they slide. The sub-blocks of a window are only merged,
+    in float, when the window is complete. The cost per sample stays
+    constant and integer.
+*/
+/**************************************************************************/
+
+#ifndef MSA300_STATS_H
+#define MSA300_STATS_H
+
+#include "MSA300.h"
+
+/*=========================================================================
+    STATISTICS
+    -----------------------------------------------------------------------*/
+    #define MSA300_STATS_MAX_BLOCK          (128)     ///< Largest sub-block, keeps the 4th power sums in 64 bits
+/*=========================================================================*/
+
+/** Sub-block accumulator. Values are in resolution units. */
+typedef struct
+{
+  int32_t  sum[3];              ///< Sum of deviations from ref
+  int64_t  sum2[3];             ///< Sum of squared deviations
+  int64_t  sum3[3];             ///< Sum of cubed deviations
+  int64_t  sum4[3];             ///< Sum of 4th power deviations
+  int64_t  vectorSum;           ///< Sum of the squared deviation vector from the tracked center
+  uint32_t vectorMax;           ///< Largest squared deviation vector from the tracked center
+  int16_t  ref[3];              ///< First sample of the sub-block
+  int16_t  min[3];              ///< Smallest value
+  int16_t  max[3];              ///< Largest value
+  uint16_t count;               ///< Number of samples
+} statsBlock_t;
+
+/** Statistics of one axis, in mg */
+typedef struct
+{
+  float mean;                   ///< Mean
+  float rms;                    ///< RMS about the mean
+  float peak;                   ///< Largest deviation from the mean
+  float peakToPeak;             ///< Largest minus smallest value
+  float crest;                  ///< Peak over RMS
+  float kurtosis;               ///< Fourth standardized moment, 3 for Gaussian vibration
+} axisStats_t;
+
+/** Statistics of one window */
+typedef struct
+{
+  axisStats_t axis[3];          ///< X, Y and Z axis
+  float    rms;                 ///< RMS of the vector deviation from the previous window's mean, in mg
+  float    peak;                ///< Largest vector deviation from the previous window's mean, in mg
+  float    crest;               ///< Vector peak over vector RMS
+  uint32_t samples;             ///< Number of samples in the window
+} stats_t;
+
+/** Class for windowed statistics. Storage for the sub-blocks of one window is supplied by the caller. */
+class MSA300Stats{
+ public:
+  MSA300Stats(statsBlock_t *blocks, uint8_t count);
+
+  bool        begin(uint16_t blockSamples, uint8_t windowBlocks, uint8_t hopBlocks, range_t range, res_t resolution);
+  void        reset(void);
+  bool        update(const rawAcc_t *sample);
+  uint16_t    update(const rawAcc_t *samples, uint16_t count);
+  bool        ready(void);
+  const stats_t *result(void);
+
+ private:
+  void        startBlock(const rawAcc_t *sample);
+  void        finishWindow(void);
+
+  statsBlock_t *_blocks;
+  uint8_t     _capacity;
+  uint16_t    _blockSamples;
+  uint8_t     _windowBlocks;
+  uint8_t     _hopBlocks;
+  uint8_t     _shift;
+  float       _mgPerLsb;
+
+  uint8_t     _current;
+  uint8_t     _filled;
+  uint8_t     _sinceWindow;
+  bool        _open;
+  bool        _ready;
+  bool        _centered;
+  int16_t     _center[3];
+  stats_t     _result;
+};
+
+#endif // MSA300_STATS_H